@@ -0,0 +1,267 @@
+#include "AllocationStats.h"
+
+#include <algorithm>
+#include <atomic>
+
+#if defined(SAVE_ALLOCATION_STATS)
+#if defined(__GLIBC__)
+#include <cerrno>
+#include <malloc.h>
+#else
+#include <cstdlib>
+#include <new>
+#endif
+#endif
+
+namespace {
+
+// Plain data so it doesn't need a constructor, which we can't run from inside malloc()
+struct ThreadCounters {
+    uint64_t allocations;
+    uint64_t bytes;
+    int64_t live;
+    int64_t peak;
+};
+
+thread_local ThreadCounters t_counters;
+std::atomic<bool> s_enabled(false);
+
+#if defined(SAVE_ALLOCATION_STATS)
+inline void allocated(const size_t size)
+{
+    if (!s_enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    ThreadCounters &counters = t_counters;
+    counters.allocations++;
+    counters.bytes += size;
+    counters.live += int64_t(size);
+    counters.peak = std::max(counters.peak, counters.live);
+}
+
+inline void released(const size_t size)
+{
+    if (!s_enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    t_counters.live -= int64_t(size);
+}
+#endif
+
+} // namespace
+
+bool AllocationStats::isAvailable()
+{
+#if defined(SAVE_ALLOCATION_STATS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AllocationStats::setEnabled(const bool enabled)
+{
+    s_enabled = enabled && isAvailable();
+}
+
+bool AllocationStats::isEnabled()
+{
+    return s_enabled.load(std::memory_order_relaxed);
+}
+
+AllocationStats::Scope::Scope(Counters *result) :
+    m_result(isEnabled() ? result : nullptr)
+{
+    if (!m_result) {
+        return;
+    }
+    ThreadCounters &counters = t_counters;
+    m_allocations = counters.allocations;
+    m_bytes = counters.bytes;
+    m_live = counters.live;
+
+    // The peak is tracked from here, and merged back into the outer one when done
+    m_outerPeak = counters.peak;
+    counters.peak = counters.live;
+}
+
+AllocationStats::Scope::~Scope()
+{
+    if (!m_result) {
+        return;
+    }
+    ThreadCounters &counters = t_counters;
+    m_result->allocations = counters.allocations - m_allocations;
+    m_result->bytes = counters.bytes - m_bytes;
+    m_result->peak = uint64_t(std::max<int64_t>(counters.peak - m_live, 0));
+    counters.peak = std::max(counters.peak, m_outerPeak);
+}
+
+#if defined(SAVE_ALLOCATION_STATS)
+#if defined(__GLIBC__)
+
+// glibc lets the executable replace these, the originals are still there
+// under other names. The sizes come from malloc_usable_size(), so frees
+// subtract exactly what was counted.
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) __THROW
+{
+    void *ptr = __libc_malloc(size);
+    if (ptr) {
+        allocated(malloc_usable_size(ptr));
+    }
+    return ptr;
+}
+
+void *calloc(size_t count, size_t size) __THROW
+{
+    void *ptr = __libc_calloc(count, size);
+    if (ptr) {
+        allocated(malloc_usable_size(ptr));
+    }
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size) __THROW
+{
+    const size_t oldSize = ptr ? malloc_usable_size(ptr) : 0;
+    void *ret = __libc_realloc(ptr, size);
+    if (ret) {
+        released(oldSize);
+        allocated(malloc_usable_size(ret));
+    } else if (size == 0) { // freed
+        released(oldSize);
+    }
+    return ret;
+}
+
+void *memalign(size_t alignment, size_t size) __THROW
+{
+    void *ptr = __libc_memalign(alignment, size);
+    if (ptr) {
+        allocated(malloc_usable_size(ptr));
+    }
+    return ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) __THROW
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **result, size_t alignment, size_t size) __THROW
+{
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void *ptr = memalign(alignment, size);
+    if (!ptr) {
+        return ENOMEM;
+    }
+    *result = ptr;
+    return 0;
+}
+
+void free(void *ptr) __THROW
+{
+    if (ptr) {
+        released(malloc_usable_size(ptr));
+    }
+    __libc_free(ptr);
+}
+
+} // extern "C"
+
+#else
+
+// The size is stored in front of each allocation, so delete knows how much is freed
+namespace {
+
+constexpr size_t headerSize = alignof(std::max_align_t);
+
+void *allocate(const size_t size)
+{
+    char *block = static_cast<char*>(std::malloc(size + headerSize));
+    if (!block) {
+        return nullptr;
+    }
+    *reinterpret_cast<size_t*>(block) = size;
+    allocated(size);
+    return block + headerSize;
+}
+
+void release(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    char *block = static_cast<char*>(ptr) - headerSize;
+    released(*reinterpret_cast<size_t*>(block));
+    std::free(block);
+}
+
+} // namespace
+
+void *operator new(size_t size)
+{
+    void *ptr = allocate(size);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    release(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    release(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    release(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+    release(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t&) noexcept
+{
+    release(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept
+{
+    release(ptr);
+}
+
+#endif
+#endif // SAVE_ALLOCATION_STATS
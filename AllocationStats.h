@@ -0,0 +1,51 @@
+#ifndef ALLOCATIONSTATS_H
+#define ALLOCATIONSTATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Counts the heap allocations of each thread, to see how much memory loading
+// a save takes and where. The allocator hooks are only built with the
+// ALLOCATION_STATS CMake option, and only count after setEnabled(true).
+// Without the option everything here does nothing.
+//
+// With glibc the hooks replace malloc() and friends, because that is what
+// the Qt containers allocate with, elsewhere they replace operator new and
+// delete. Memory freed by another thread than the one that allocated it is
+// subtracted from the live bytes of the thread freeing it.
+class AllocationStats
+{
+public:
+    struct Counters {
+        uint64_t allocations = 0;
+        uint64_t bytes = 0; // allocated in total, frees don't subtract
+        uint64_t peak = 0;  // highest live bytes above what was live when counting started
+    };
+
+    // If the hooks are compiled in
+    static bool isAvailable();
+
+    static void setEnabled(const bool enabled);
+    static bool isEnabled();
+
+    // Counts what the current thread allocates during its lifetime into
+    // result, if counting is enabled. Can be nested.
+    class Scope
+    {
+    public:
+        explicit Scope(Counters *result);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope &operator=(const Scope&) = delete;
+
+    private:
+        Counters *m_result;
+        uint64_t m_allocations = 0;
+        uint64_t m_bytes = 0;
+        int64_t m_live = 0;
+        int64_t m_outerPeak = 0;
+    };
+};
+
+#endif // ALLOCATIONSTATS_H
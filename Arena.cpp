@@ -0,0 +1,83 @@
+#include "Arena.h"
+
+#include <cstdint>
+#include <utility>
+
+Arena::Arena(Arena &&other) noexcept
+    : m_blockSize(other.m_blockSize),
+      m_blocks(std::move(other.m_blocks)),
+      m_bigBlocks(std::move(other.m_bigBlocks)),
+      m_current(std::exchange(other.m_current, nullptr)),
+      m_remaining(std::exchange(other.m_remaining, 0)),
+      m_bytesAllocated(std::exchange(other.m_bytesAllocated, 0))
+{
+    other.m_blocks.clear();
+    other.m_bigBlocks.clear();
+}
+
+Arena &Arena::operator=(Arena &&other) noexcept
+{
+    if (this == &other) {
+        return *this;
+    }
+    m_blockSize = other.m_blockSize;
+    m_blocks = std::move(other.m_blocks);
+    other.m_blocks.clear();
+    m_bigBlocks = std::move(other.m_bigBlocks);
+    other.m_bigBlocks.clear();
+    m_current = std::exchange(other.m_current, nullptr);
+    m_remaining = std::exchange(other.m_remaining, 0);
+    m_bytesAllocated = std::exchange(other.m_bytesAllocated, 0);
+    return *this;
+}
+
+static size_t padding(const char *pointer, const size_t alignment)
+{
+    return (alignment - (reinterpret_cast<uintptr_t>(pointer) & (alignment - 1))) & (alignment - 1);
+}
+
+void *Arena::allocate(const size_t size, const size_t alignment)
+{
+    Q_ASSERT(alignment && (alignment & (alignment - 1)) == 0);
+
+    // Big ones get a block of their own, so the current block isn't wasted
+    if (size + alignment > m_blockSize) {
+        const size_t blockSize = size + alignment;
+        Block block{std::unique_ptr<char[]>(new char[blockSize]), blockSize};
+        char *data = block.data.get();
+        m_bytesAllocated += blockSize;
+        m_bigBlocks.push_back(std::move(block));
+        return data + padding(data, alignment);
+    }
+
+    size_t offset = padding(m_current, alignment);
+    if (!m_current || size + offset > m_remaining) {
+        Block block{std::unique_ptr<char[]>(new char[m_blockSize]), m_blockSize};
+        m_current = block.data.get();
+        m_remaining = m_blockSize;
+        m_bytesAllocated += m_blockSize;
+        m_blocks.push_back(std::move(block));
+        offset = padding(m_current, alignment);
+    }
+
+    void *ret = m_current + offset;
+    m_current += offset + size;
+    m_remaining -= offset + size;
+    return ret;
+}
+
+void Arena::reset()
+{
+    m_bigBlocks.clear();
+    if (m_blocks.empty()) {
+        m_current = nullptr;
+        m_remaining = 0;
+        m_bytesAllocated = 0;
+        return;
+    }
+
+    m_blocks.resize(1);
+    m_current = m_blocks.front().data.get();
+    m_remaining = m_blocks.front().size;
+    m_bytesAllocated = m_remaining;
+}
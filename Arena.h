@@ -0,0 +1,68 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <QtGlobal>
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for things that live exactly as long as one parsed save.
+// Nothing is freed on its own, reset() or the destructor frees everything
+// at once. Not thread safe.
+class Arena
+{
+public:
+    explicit Arena(const size_t blockSize = 64 * 1024) : m_blockSize(blockSize) {}
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    // Leave the other one empty, it can't keep pointing into our blocks
+    Arena(Arena &&other) noexcept;
+    Arena &operator=(Arena &&other) noexcept;
+
+    void *allocate(const size_t size, const size_t alignment = alignof(std::max_align_t));
+
+    // Uninitialized, only for types that don't need destructing
+    template<typename T>
+    T *allocateArray(const size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "the arena never calls destructors");
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // Keeps the first regular sized block around for reuse
+    void reset();
+
+    // In the blocks, including what's lost to alignment and unused block ends
+    size_t bytesAllocated() const { return m_bytesAllocated; }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    size_t m_blockSize;
+    std::vector<Block> m_blocks; // all m_blockSize, the last one is being filled
+    std::vector<Block> m_bigBlocks; // one per allocation that doesn't fit in a regular one
+    char *m_current = nullptr;
+    size_t m_remaining = 0;
+    size_t m_bytesAllocated = 0;
+};
+
+// A flat array in an arena
+template<typename T>
+struct ArrayView
+{
+    const T *begin() const { return data; }
+    const T *end() const { return data + count; }
+    const T &operator[](const int index) const { Q_ASSERT(index >= 0 && index < count); return data[index]; }
+    int size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+
+    const T *data = nullptr;
+    int count = 0;
+};
+
+#endif // ARENA_H
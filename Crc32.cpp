@@ -0,0 +1,371 @@
+#include "Crc32.h"
+
+#include <QtEndian>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#if defined(Q_PROCESSOR_X86_64) && defined(Q_CC_GNU)
+#define CRC32_HAVE_PCLMUL 1
+#include <immintrin.h>
+#endif
+
+namespace crc32 {
+
+static constexpr quint32 s_polynomial = 0xedb88320;
+
+using Tables = std::array<std::array<quint32, 256>, 16>;
+
+static constexpr Tables createTables()
+{
+    Tables tables{};
+    for (quint32 i=0; i<256; i++) {
+        quint32 val = i;
+        for (int bit=0; bit<8; bit++) {
+            val = (val & 1) ? (val >> 1) ^ s_polynomial : val >> 1;
+        }
+        tables[0][i] = val;
+    }
+    for (size_t slice=1; slice<tables.size(); slice++) {
+        for (size_t i=0; i<256; i++) {
+            const quint32 previous = tables[slice - 1][i];
+            tables[slice][i] = (previous >> 8) ^ tables[0][previous & 0xff];
+        }
+    }
+    return tables;
+}
+
+static constexpr Tables s_tables = createTables();
+
+// Works on the raw (inverted) state, so the SIMD path can hand over its tail
+static quint32 updateSliceBy16(quint32 crc, const uchar *data, size_t length)
+{
+    const auto &t = s_tables;
+
+    while (length >= 16) {
+        const quint32 a = crc ^ qFromLittleEndian<quint32>(data);
+        const quint32 b = qFromLittleEndian<quint32>(data + 4);
+        const quint32 c = qFromLittleEndian<quint32>(data + 8);
+        const quint32 d = qFromLittleEndian<quint32>(data + 12);
+
+        crc = t[15][a & 0xff] ^ t[14][(a >> 8) & 0xff] ^ t[13][(a >> 16) & 0xff] ^ t[12][a >> 24]
+            ^ t[11][b & 0xff] ^ t[10][(b >> 8) & 0xff] ^ t[9][(b >> 16) & 0xff] ^ t[8][b >> 24]
+            ^ t[7][c & 0xff] ^ t[6][(c >> 8) & 0xff] ^ t[5][(c >> 16) & 0xff] ^ t[4][c >> 24]
+            ^ t[3][d & 0xff] ^ t[2][(d >> 8) & 0xff] ^ t[1][(d >> 16) & 0xff] ^ t[0][d >> 24];
+
+        data += 16;
+        length -= 16;
+    }
+
+    if (length >= 8) {
+        const quint32 a = crc ^ qFromLittleEndian<quint32>(data);
+        const quint32 b = qFromLittleEndian<quint32>(data + 4);
+
+        crc = t[7][a & 0xff] ^ t[6][(a >> 8) & 0xff] ^ t[5][(a >> 16) & 0xff] ^ t[4][a >> 24]
+            ^ t[3][b & 0xff] ^ t[2][(b >> 8) & 0xff] ^ t[1][(b >> 16) & 0xff] ^ t[0][b >> 24];
+
+        data += 8;
+        length -= 8;
+    }
+
+    while (length--) {
+        crc = t[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+quint32 calculateSliceBy16(const uchar *data, size_t length, const quint32 seed)
+{
+    return ~updateSliceBy16(~seed, data, length);
+}
+
+#ifdef CRC32_HAVE_PCLMUL
+
+bool hasPclmul()
+{
+    static const bool supported = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+    return supported;
+}
+
+// Folding as described in Intel's "Fast CRC Computation for Generic Polynomials
+// Using PCLMULQDQ Instruction", with the bit-reflected constants for 0xedb88320.
+// Needs at least 64 bytes and a multiple of 16, returns the raw state.
+__attribute__((target("pclmul,sse4.1")))
+static quint32 updatePclmul(const quint32 crc, const uchar *data, size_t length)
+{
+    alignas(16) static const quint64 k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+    alignas(16) static const quint64 k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+    alignas(16) static const quint64 k5k0[] = { 0x0163cd6124, 0x0000000000 };
+    alignas(16) static const quint64 poly[] = { 0x01db710641, 0x01f7011641 };
+
+    __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x00));
+    __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x10));
+    __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x20));
+    __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(int(crc)));
+
+    __m128i x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+
+    data += 64;
+    length -= 64;
+
+    // Fold four blocks in parallel
+    while (length >= 64) {
+        const __m128i x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        const __m128i x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        const __m128i x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        const __m128i x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        const __m128i y5 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x00));
+        const __m128i y6 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x10));
+        const __m128i y7 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x20));
+        const __m128i y8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        data += 64;
+        length -= 64;
+    }
+
+    // Fold down to 128 bits
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+
+    for (const __m128i next : { x2, x3, x4 }) {
+        const __m128i x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, next), x5);
+    }
+
+    // Remaining single 16 byte blocks
+    while (length >= 16) {
+        const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        const __m128i x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, next), x5);
+
+        data += 16;
+        length -= 16;
+    }
+
+    // 128 -> 64 bits
+    __m128i x2r = _mm_clmulepi64_si128(x1, x0, 0x10);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2r);
+
+    x0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+
+    x2r = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2r);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+
+    x2r = _mm_and_si128(x1, mask32);
+    x2r = _mm_clmulepi64_si128(x2r, x0, 0x10);
+    x2r = _mm_and_si128(x2r, mask32);
+    x2r = _mm_clmulepi64_si128(x2r, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2r);
+
+    return quint32(_mm_extract_epi32(x1, 1));
+}
+
+quint32 calculatePclmul(const uchar *data, size_t length, const quint32 seed)
+{
+    quint32 crc = ~seed;
+    if (length >= 64) {
+        const size_t folded = length & ~size_t(15);
+        crc = updatePclmul(crc, data, folded);
+        data += folded;
+        length -= folded;
+    }
+    return ~updateSliceBy16(crc, data, length);
+}
+
+#else // CRC32_HAVE_PCLMUL
+
+bool hasPclmul()
+{
+    return false;
+}
+
+quint32 calculatePclmul(const uchar *data, size_t length, const quint32 seed)
+{
+    return calculateSliceBy16(data, length, seed);
+}
+
+#endif // CRC32_HAVE_PCLMUL
+
+quint32 calculate(const uchar *data, size_t length, const quint32 seed)
+{
+    // Below this the setup and reduction cost more than the tables
+    static constexpr size_t pclmulThreshold = 256;
+
+    if (length >= pclmulThreshold && hasPclmul()) {
+        return calculatePclmul(data, length, seed);
+    }
+    return calculateSliceBy16(data, length, seed);
+}
+
+// The CRC of a message extended with n zero bytes is a linear function of the
+// original CRC, so it can be represented as a 32x32 matrix over GF(2). This is
+// the same approach as zlib's crc32_combine().
+using Gf2Matrix = std::array<quint32, 32>;
+
+static quint32 gf2MatrixTimes(const Gf2Matrix &matrix, quint32 vector)
+{
+    quint32 sum = 0;
+    for (int i=0; vector; i++, vector >>= 1) {
+        if (vector & 1) {
+            sum ^= matrix[i];
+        }
+    }
+    return sum;
+}
+
+static Gf2Matrix gf2MatrixSquare(const Gf2Matrix &matrix)
+{
+    Gf2Matrix square;
+    for (size_t i=0; i<square.size(); i++) {
+        square[i] = gf2MatrixTimes(matrix, matrix[i]);
+    }
+    return square;
+}
+
+quint32 combine(const quint32 crcA, const quint32 crcB, size_t lengthB)
+{
+    if (lengthB == 0) {
+        return crcA;
+    }
+
+    // Operator for one zero bit
+    Gf2Matrix odd;
+    odd[0] = s_polynomial;
+    for (size_t i=1; i<odd.size(); i++) {
+        odd[i] = 1u << (i - 1);
+    }
+
+    Gf2Matrix even = gf2MatrixSquare(odd); // two zero bits
+    odd = gf2MatrixSquare(even); // four zero bits
+
+    // Apply len2 zero bytes to crcA, squaring the operator for each bit of the length
+    quint32 crc = crcA;
+    do {
+        even = gf2MatrixSquare(odd);
+        if (lengthB & 1) {
+            crc = gf2MatrixTimes(even, crc);
+        }
+        lengthB >>= 1;
+        if (!lengthB) {
+            break;
+        }
+
+        odd = gf2MatrixSquare(even);
+        if (lengthB & 1) {
+            crc = gf2MatrixTimes(odd, crc);
+        }
+        lengthB >>= 1;
+    } while (lengthB);
+
+    return crc ^ crcB;
+}
+
+quint32 update(const uchar *difference, size_t length, size_t bytesAfter)
+{
+    // Without the inversion at the start and the end the CRC is linear, and
+    // leading zeros don't change it. The CRC of as many zeros is exactly
+    // what the inversions add, so XOR that out.
+    static const std::array<uchar, 64> zeros = {};
+    quint32 zerosCrc = 0;
+    for (size_t done = 0; done < length; done += zeros.size()) {
+        zerosCrc = calculate(zeros.data(), qMin(zeros.size(), length - done), zerosCrc);
+    }
+    const quint32 linear = calculate(difference, length, 0) ^ zerosCrc;
+
+    // And the bytes after it are like appending zeros
+    return combine(linear, 0, bytesAfter);
+}
+
+namespace {
+
+// One chunk of calculateParallel(), owned by the caller so it can take it
+// back from the pool if no thread has picked it up yet
+class ChunkTask : public QRunnable
+{
+public:
+    ChunkTask(const uchar *data, const size_t length, quint32 *result, QSemaphore *done) :
+        m_data(data), m_length(length), m_result(result), m_done(done)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        *m_result = calculate(m_data, m_length, 0);
+        m_done->release();
+    }
+
+private:
+    const uchar *m_data;
+    size_t m_length;
+    quint32 *m_result;
+    QSemaphore *m_done;
+};
+
+} // namespace
+
+quint32 calculateParallel(const uchar *data, size_t length, const quint32 seed, const size_t minimumChunkSize)
+{
+    QThreadPool *pool = QThreadPool::globalInstance();
+    const size_t threads = size_t(qMax(1, pool->maxThreadCount()));
+    const size_t chunkSize = qMax(minimumChunkSize, (length + threads - 1) / threads);
+    if (chunkSize >= length) {
+        return calculate(data, length, seed);
+    }
+
+    // Only the first chunk gets the real seed, the rest are combined onto it
+    const size_t chunkCount = (length + chunkSize - 1) / chunkSize;
+    std::vector<quint32> partials(chunkCount);
+    QSemaphore done;
+    std::vector<std::unique_ptr<ChunkTask>> tasks;
+    for (size_t i=1; i<chunkCount; i++) {
+        const size_t offset = i * chunkSize;
+        tasks.emplace_back(new ChunkTask(data + offset, qMin(chunkSize, length - offset), &partials[i], &done));
+        pool->start(tasks.back().get());
+    }
+
+    partials[0] = calculate(data, chunkSize, seed);
+
+    // Do whatever the pool hasn't started yet ourselves, otherwise we could
+    // wait forever when called from a pool thread with the pool busy
+    for (const std::unique_ptr<ChunkTask> &task : tasks) {
+        if (pool->tryTake(task.get())) {
+            task->run();
+        }
+    }
+    done.acquire(int(tasks.size()));
+
+    quint32 crc = partials[0];
+    for (size_t i=1; i<chunkCount; i++) {
+        crc = combine(crc, partials[i], qMin(chunkSize, length - i * chunkSize));
+    }
+    return crc;
+}
+
+} // namespace crc32
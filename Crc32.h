@@ -0,0 +1,39 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <QtGlobal>
+
+namespace crc32 {
+
+// Same CRC as the save files use (reflected 0xedb88320, zlib compatible):
+// calculate(data, length, seed) == zlib's crc32(seed, data, length)
+quint32 calculate(const uchar *data, size_t length, const quint32 seed);
+
+// Portable table driven implementation, always available
+quint32 calculateSliceBy16(const uchar *data, size_t length, const quint32 seed);
+
+// Carry-less multiplication folding, returns false if the CPU doesn't have PCLMULQDQ
+bool hasPclmul();
+quint32 calculatePclmul(const uchar *data, size_t length, const quint32 seed);
+
+// Merges the CRC of A (any seed) with the CRC of B (seed 0) into the CRC of A+B
+quint32 combine(const quint32 crcA, const quint32 crcB, size_t lengthB);
+
+// How the CRC of a block changes when length bytes, followed by bytesAfter
+// more bytes up to the end of the block, are XORed with difference. CRCs are
+// linear, so crc(edited) == crc(original) ^ update(difference, length, bytesAfter)
+// regardless of the seed or the rest of the block.
+quint32 update(const uchar *difference, size_t length, size_t bytesAfter);
+
+// Splits the data into chunks that are checksummed on the global thread pool,
+// the partial results are merged with combine(). Gives the same result as calculate().
+quint32 calculateParallel(const uchar *data, size_t length, const quint32 seed, const size_t minimumChunkSize = 256 * 1024);
+
+} // namespace crc32
+
+static inline quint32 calculateCrc32(const char *data, const size_t length, const quint32 seed)
+{
+    return crc32::calculate(reinterpret_cast<const uchar*>(data), length, seed);
+}
+
+#endif // CRC32_H
@@ -1,23 +1,121 @@
 #include "MainWindow.h"
 
 #include "SaveFile.h"
-#include <QFile>
+#include "SaveLoader.h"
+#include "SaveWatcher.h"
 #include <QDebug>
+#include <QStatusBar>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QFutureWatcher>
+#include <QtConcurrent>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
 {
-    m_saveFile = new SaveFile(this);
+    m_progressBar = new QProgressBar(this);
+    m_progressBar->setRange(0, SaveFile::NumStages * 100);
+    m_progressBar->hide();
+    statusBar()->addPermanentWidget(m_progressBar);
 
-    QFile file("/home/sandsmark/src/masseffectandromeda-save-editor/Careerfe87459e-0AutoSave");
-    if (!file.open(QIODevice::ReadOnly)) {
-        qWarning() << "failed open";
+    m_cancelButton = new QPushButton(tr("Cancel"), this);
+    m_cancelButton->hide();
+    connect(m_cancelButton, &QPushButton::clicked, this, &MainWindow::cancelLoading);
+    statusBar()->addPermanentWidget(m_cancelButton);
+
+    openSave("/home/sandsmark/src/masseffectandromeda-save-editor/Careerfe87459e-0AutoSave");
+}
+
+MainWindow::~MainWindow()
+{
+    // The loaders are our children, so wait for the workers to let go of them
+    cancelLoading();
+    for (QFutureWatcher<bool> *load : findChildren<QFutureWatcher<bool>*>()) {
+        load->waitForFinished();
+    }
+}
+
+void MainWindow::openSave(const QString &path)
+{
+    cancelLoading();
+
+    SaveLoader *loader = new SaveLoader(this);
+    m_loader = loader;
+    connect(loader, &SaveLoader::progress, this, &MainWindow::onLoadProgress);
+
+    QFutureWatcher<bool> *load = new QFutureWatcher<bool>(this);
+    connect(load, &QFutureWatcher<bool>::finished, this, [=]() {
+        onLoadFinished(loader, path, load->result());
+        load->deleteLater();
+    });
+    load->setFuture(QtConcurrent::run([loader, path]() {
+        return loader->load(path);
+    }));
+
+    m_progressBar->setValue(0);
+    m_progressBar->show();
+    m_cancelButton->show();
+    statusBar()->showMessage(tr("Loading %1").arg(path));
+}
+
+void MainWindow::cancelLoading()
+{
+    if (!m_loader) {
+        return;
+    }
+
+    // Deleted when the worker notices
+    m_loader->cancel();
+    disconnect(m_loader, &SaveLoader::progress, this, &MainWindow::onLoadProgress);
+    m_loader = nullptr;
+
+    m_progressBar->hide();
+    m_cancelButton->hide();
+    statusBar()->showMessage(tr("Loading cancelled"));
+}
+
+void MainWindow::onLoadProgress(const int stage, const qint64 done, const qint64 total)
+{
+    const int stageProgress = total > 0 ? int(done * 100 / total) : 100;
+    m_progressBar->setValue(stage * 100 + stageProgress);
+    m_progressBar->setFormat(QString::fromLatin1(QMetaEnum::fromType<SaveFile::Stage>().valueToKey(stage)));
+}
+
+void MainWindow::onLoadFinished(SaveLoader *loader, const QString &path, const bool ok)
+{
+    loader->deleteLater();
+    if (loader != m_loader) {
+        // Cancelled or replaced by another one
         return;
     }
-    m_saveFile->load(&file);
+    m_loader = nullptr;
+
+    m_progressBar->hide();
+    m_cancelButton->hide();
+
+    if (!ok) {
+        statusBar()->showMessage(tr("Failed to load %1").arg(path));
+        return;
+    }
+
+    m_saveFile.reset(new SaveFile(loader->takeSaveFile()));
+    statusBar()->showMessage(tr("Loaded %1").arg(path));
 }
 
-MainWindow::~MainWindow()
+void MainWindow::watchDirectory(const QString &directory)
+{
+    delete m_watcher;
+    m_watcher = new SaveWatcher(directory, this);
+    connect(m_watcher, &SaveWatcher::saveLoaded, this, &MainWindow::onSaveLoaded);
+    connect(m_watcher, &SaveWatcher::saveFailed, this, [this](const QString &path) {
+        statusBar()->showMessage(tr("Failed to load %1").arg(path));
+    });
+    statusBar()->showMessage(tr("Watching %1").arg(m_watcher->directory()));
+}
+
+void MainWindow::onSaveLoaded(const QString &path, QSharedPointer<SaveFile> saveFile)
 {
+    m_saveFile = saveFile;
+    statusBar()->showMessage(tr("%1: %2").arg(path, saveFile->data().levelName()));
 }
 
@@ -2,8 +2,13 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QSharedPointer>
 
 class SaveFile;
+class SaveLoader;
+class SaveWatcher;
+class QProgressBar;
+class QPushButton;
 
 class MainWindow : public QMainWindow
 {
@@ -13,8 +18,23 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    // Loads in a worker thread, replacing the current save when done
+    void openSave(const QString &path);
+    void cancelLoading();
+
+    // Loads each save the game writes to the directory
+    void watchDirectory(const QString &directory);
+
 private:
+    void onLoadProgress(const int stage, const qint64 done, const qint64 total);
+    void onLoadFinished(SaveLoader *loader, const QString &path, const bool ok);
+    void onSaveLoaded(const QString &path, QSharedPointer<SaveFile> saveFile);
+
+    QSharedPointer<SaveFile> m_saveFile;
+    SaveLoader *m_loader = nullptr;
+    QProgressBar *m_progressBar;
+    QPushButton *m_cancelButton;
 
-    SaveFile *m_saveFile;
+    SaveWatcher *m_watcher = nullptr;
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,217 @@
+#include "SaveBuffer.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+
+#include <cstring>
+
+SaveBuffer::SaveBuffer(const QByteArray &data, const int chunkSize) :
+    m_chunkSize(chunkSize),
+    m_size(data.size())
+{
+    m_chunks.reserve(int((m_size + m_chunkSize - 1) / m_chunkSize));
+    for (qint64 offset = 0; offset < m_size; offset += m_chunkSize) {
+        m_chunks.append(data.mid(int(offset), m_chunkSize));
+    }
+}
+
+bool SaveBuffer::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open" << path << file.errorString();
+        return false;
+    }
+    return load(&file);
+}
+
+bool SaveBuffer::load(QIODevice *input)
+{
+    Q_ASSERT(input->isReadable());
+
+    QVector<QByteArray> chunks;
+    qint64 size = 0;
+    for (;;) {
+        // Devices can return less than asked for, only the last chunk may be short
+        QByteArray chunk(m_chunkSize, Qt::Uninitialized);
+        int filled = 0;
+        while (filled < m_chunkSize) {
+            const qint64 count = input->read(chunk.data() + filled, m_chunkSize - filled);
+            if (count < 0) {
+                qWarning() << "Failed to read save" << input->errorString();
+                return false;
+            }
+            if (count == 0) {
+                break;
+            }
+            filled += int(count);
+        }
+        if (filled == 0) {
+            break;
+        }
+        chunk.truncate(filled);
+        chunks.append(chunk);
+        size += filled;
+        if (filled < m_chunkSize) {
+            break;
+        }
+    }
+
+    m_chunks = chunks;
+    m_size = size;
+    clearHistory();
+    return true;
+}
+
+bool SaveBuffer::save(const QString &path) const
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open" << path << file.errorString();
+        return false;
+    }
+    if (!save(&file)) {
+        file.cancelWriting();
+        return false;
+    }
+    if (!file.commit()) {
+        qWarning() << "Failed to write" << path << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool SaveBuffer::save(QIODevice *output) const
+{
+    Q_ASSERT(output->isWritable());
+
+    for (const QByteArray &chunk : m_chunks) {
+        if (output->write(chunk) != chunk.size()) {
+            qWarning() << "Failed to write save" << output->errorString();
+            return false;
+        }
+    }
+    return true;
+}
+
+QByteArray SaveBuffer::read(const qint64 offset, const qint64 length) const
+{
+    QByteArray ret;
+    if (offset < 0 || length <= 0 || offset >= m_size) {
+        return ret;
+    }
+
+    const qint64 end = qMin(m_size, offset + length);
+    ret.reserve(int(end - offset));
+    for (qint64 position = offset; position < end;) {
+        const QByteArray &chunk = m_chunks[int(position / m_chunkSize)];
+        const int chunkOffset = int(position % m_chunkSize);
+        const int count = int(qMin(qint64(chunk.size() - chunkOffset), end - position));
+        ret.append(chunk.constData() + chunkOffset, count);
+        position += count;
+    }
+    return ret;
+}
+
+bool SaveBuffer::write(const qint64 offset, const QByteArray &bytes)
+{
+    if (offset < 0 || offset + bytes.size() > m_size) {
+        qWarning() << "Write outside of the buffer" << offset << bytes.size() << m_size;
+        return false;
+    }
+
+    for (qint64 done = 0; done < bytes.size();) {
+        const qint64 position = offset + done;
+        const int index = int(position / m_chunkSize);
+        const int chunkOffset = int(position % m_chunkSize);
+        const int count = int(qMin(qint64(m_chunkSize - chunkOffset), bytes.size() - done));
+
+        // Keeps the old version alive, so the data() below copies the chunk
+        // the first time it's written to in this step
+        if (!m_pending.contains(index)) {
+            m_pending.insert(index, m_chunks[index]);
+        }
+        memcpy(m_chunks[index].data() + chunkOffset, bytes.constData() + done, count);
+        done += count;
+    }
+
+    m_redoSteps.clear();
+    return true;
+}
+
+QByteArray SaveBuffer::toByteArray() const
+{
+    return read(0, m_size);
+}
+
+void SaveBuffer::commit(const QString &description)
+{
+    if (m_pending.isEmpty()) {
+        return;
+    }
+
+    Step step;
+    step.description = description;
+    step.chunks.reserve(m_pending.count());
+    for (auto it = m_pending.constBegin(); it != m_pending.constEnd(); ++it) {
+        step.chunks.append(qMakePair(it.key(), it.value()));
+    }
+    m_pending.clear();
+
+    m_undoSteps.append(step);
+}
+
+QString SaveBuffer::undoText() const
+{
+    if (!m_pending.isEmpty() || m_undoSteps.isEmpty()) {
+        return QString();
+    }
+    return m_undoSteps.last().description;
+}
+
+QString SaveBuffer::redoText() const
+{
+    if (!canRedo()) {
+        return QString();
+    }
+    return m_redoSteps.last().description;
+}
+
+bool SaveBuffer::undo()
+{
+    commit(QString());
+
+    if (m_undoSteps.isEmpty()) {
+        return false;
+    }
+    Step step = m_undoSteps.takeLast();
+    swapChunks(&step);
+    m_redoSteps.append(step);
+    return true;
+}
+
+bool SaveBuffer::redo()
+{
+    if (!canRedo()) {
+        return false;
+    }
+    Step step = m_redoSteps.takeLast();
+    swapChunks(&step);
+    m_undoSteps.append(step);
+    return true;
+}
+
+void SaveBuffer::clearHistory()
+{
+    m_pending.clear();
+    m_undoSteps.clear();
+    m_redoSteps.clear();
+}
+
+void SaveBuffer::swapChunks(Step *step)
+{
+    for (QPair<int, QByteArray> &chunk : step->chunks) {
+        m_chunks[chunk.first].swap(chunk.second);
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef SAVEBUFFER_H
+#define SAVEBUFFER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+class QIODevice;
+
+// The bytes of a save being edited, split into fixed size chunks that are
+// implicitly shared. Writing only copies the chunks it touches, and an undo
+// step holds on to the previous versions of just those chunks, so undo and
+// redo swap a few chunks instead of copying the whole file.
+class SaveBuffer
+{
+public:
+    static constexpr int ChunkSize = 64 * 1024;
+
+    // Smaller chunks are only useful for testing writes across chunks
+    explicit SaveBuffer(const int chunkSize = ChunkSize) : m_chunkSize(chunkSize) {}
+    explicit SaveBuffer(const QByteArray &data, const int chunkSize = ChunkSize);
+
+    // Reads a chunk at a time, clears the undo history
+    bool load(QIODevice *input);
+    bool load(const QString &path);
+
+    // Writes the chunks one after another, nothing is flattened first
+    bool save(QIODevice *output) const;
+    bool save(const QString &path) const; // replaces the file atomically
+
+    qint64 size() const { return m_size; }
+
+    // Returns fewer bytes if reading past the end
+    QByteArray read(const qint64 offset, const qint64 length) const;
+
+    // Overwrites existing bytes, the size never changes. Returns false if it doesn't fit.
+    bool write(const qint64 offset, const QByteArray &bytes);
+
+    QByteArray toByteArray() const;
+
+    // Ends the current undo step, all writes since the last one are undone together
+    void commit(const QString &description);
+
+    bool canUndo() const { return !m_pending.isEmpty() || !m_undoSteps.isEmpty(); }
+    bool canRedo() const { return m_pending.isEmpty() && !m_redoSteps.isEmpty(); }
+    QString undoText() const;
+    QString redoText() const;
+
+    // Uncommitted writes are committed first, so they are what gets undone.
+    // Use SaveFile::undo() and redo() for steps made with SaveFile::patch(),
+    // so the values in the SaveFile follow.
+    bool undo();
+    bool redo();
+
+    void clearHistory();
+
+private:
+    struct Step {
+        QString description;
+        // The other version of each chunk the step changed, swapped with
+        // the current one on undo and swapped back on redo
+        QVector<QPair<int, QByteArray>> chunks;
+    };
+
+    void swapChunks(Step *step);
+
+    int m_chunkSize = ChunkSize;
+    QVector<QByteArray> m_chunks;
+    qint64 m_size = 0;
+
+    // What the chunks written since the last commit looked like before
+    QHash<int, QByteArray> m_pending;
+
+    QVector<Step> m_undoSteps;
+    QVector<Step> m_redoSteps;
+};
+
+#endif // SAVEBUFFER_H
@@ -0,0 +1,202 @@
+#include "SaveDataView.h"
+#include "Crc32.h"
+#include "SaveSchema.h"
+
+#include <QDebug>
+
+#include <new>
+
+// Goes through the same schema as SaveData::load(), but the string reading
+// functions the codecs call are replaced with ones that make views. The rest
+// of the fields end up in the SaveData base as usual.
+struct SaveDataView::Decoder : public SaveData
+{
+    Decoder(SaveDataView *view) : m_view(view) {}
+
+    template<QSysInfo::Endian Endian>
+    bool decode(bits::bitreader *input);
+
+    void recordField(const char *name) {
+        m_field = name;
+    }
+
+    template<QSysInfo::Endian Endian>
+    QLatin1String readView() {
+        const quint16 length = read<quint16, Endian>();
+        if (length == 0) {
+            return QLatin1String();
+        }
+        if (length > 1000) { // same as BaseSave::readString()
+            qWarning() << "Unrealistically long string" << length;
+            m_ok = false;
+            return QLatin1String();
+        }
+        if (m_input->position() / 8 + length > m_input->size()) {
+            qWarning() << "String past the end of the data" << length;
+            m_ok = false;
+            return QLatin1String();
+        }
+
+        if (m_input->aligned()) {
+            const char *start = reinterpret_cast<const char*>(m_input->ptr()) + m_input->position() / 8;
+            bool ascii = true;
+            for (int i=0; i<length && ascii; i++) {
+                ascii = !(start[i] & 0x80);
+            }
+            if (ascii) {
+                m_input->skip(length * 8);
+                return QLatin1String(start, length);
+            }
+        }
+
+        char *copy = m_view->m_arena.allocateArray<char>(length);
+        m_input->readbytes(reinterpret_cast<quint8*>(copy), length, 0x7f);
+        return QLatin1String(copy, length);
+    }
+
+    // Hide the ones in BaseSave, the codecs get an empty value and the view gets the string
+    template<QSysInfo::Endian Endian>
+    QString readString() {
+        m_view->m_strings.append(NamedString{m_field, readView<Endian>()});
+        return QString();
+    }
+
+    template<QSysInfo::Endian Endian>
+    QStringList readStringList() {
+        const quint16 count = read<quint16, Endian>();
+        QLatin1String *strings = m_view->m_arena.allocateArray<QLatin1String>(count);
+        for (int i=0; i<count; i++) {
+            new (strings + i) QLatin1String(readView<Endian>());
+            if (!m_ok) {
+                return QStringList();
+            }
+        }
+        m_view->m_stringLists.append(NamedStringList{m_field, ArrayView<QLatin1String>{strings, count}});
+        return QStringList();
+    }
+
+    SaveDataView *m_view;
+    const char *m_field = nullptr;
+};
+
+template<QSysInfo::Endian Endian>
+bool SaveDataView::Decoder::decode(bits::bitreader *input)
+{
+    m_endian = Endian;
+    m_input = input;
+
+    if (!BaseSave::load<Endian>()) {
+        return false;
+    }
+
+    if (!schema::read<Endian>(*this, schema::saveDataPrefix)) {
+        return false;
+    }
+    const bool supportedVersion = schema::forSaveVersion(m_saveVersion, [this](auto version) {
+        schema::read<Endian, decltype(version)::value>(*this, schema::saveDataBody);
+    });
+    if (!supportedVersion) {
+        qWarning() << "unsupported save version" << m_saveVersion;
+        return false;
+    }
+    if (m_gameVersion != 3) {
+        qWarning() << "unsupported game version" << m_gameVersion;
+        return false;
+    }
+    if (m_input->overrun()) {
+        qWarning() << "Read past the end of the data";
+        return false;
+    }
+
+    // The remainder is left where it is
+    m_remainderBits = qint64(m_input->size()) * 8 - m_input->position();
+    m_input = nullptr;
+
+    return m_ok;
+}
+
+bool SaveDataView::load(const char *file, const qint64 size)
+{
+    clear();
+
+    static constexpr quint64 fileHeader(0x534B4E5548434246); // FBCHUNKS
+    if (size < qint64(sizeof(quint64))) {
+        qWarning() << "failed to read header";
+        return false;
+    }
+    if (qFromLittleEndian<quint64>(file) == fileHeader) {
+        return load<QSysInfo::LittleEndian>(file, size);
+    } else if (qFromBigEndian<quint64>(file) == fileHeader) {
+        return load<QSysInfo::BigEndian>(file, size);
+    }
+
+    qWarning() << "Unknown endianness" << QByteArray(file, sizeof(quint64));
+    return false;
+}
+
+template<QSysInfo::Endian Endian>
+bool SaveDataView::load(const char *file, const qint64 size)
+{
+    Serializable reader;
+    reader.m_endian = Endian;
+    reader.setInput(file, size);
+
+    reader.read(sizeof(quint64)); // magic
+    reader.read<quint16, Endian>(); // version
+    const quint32 headerLength = reader.read<quint32, Endian>();
+    const quint32 dataLength = reader.read<quint32, Endian>();
+    if (!reader.m_ok || dataLength < sizeof(quint32)) {
+        qWarning() << "Invalid preamble";
+        return false;
+    }
+    reader.read(headerLength); // with its checksum
+
+    const quint32 dataChecksum = reader.read<quint32, Endian>();
+    const qint64 dataSize = qint64(dataLength) - qint64(sizeof(dataChecksum));
+    const char *data = reader.read(dataSize);
+    if (!data) {
+        qWarning() << "Short read of data" << dataSize;
+        return false;
+    }
+    const quint32 calculatedDataChecksum = calculateCrc32(data, dataSize, 0x12345678);
+    if (dataChecksum != calculatedDataChecksum) {
+        qWarning() << "Invalid data checksum" << dataChecksum << "expected" << calculatedDataChecksum;
+        return false;
+    }
+
+    bits::bitreader input(reinterpret_cast<const uchar*>(data), dataSize);
+    Decoder decoder(this);
+    const bool ok = decoder.decode<Endian>(&input);
+    m_fields = decoder;
+    if (!ok) {
+        clear();
+    }
+    return ok;
+}
+
+void SaveDataView::clear()
+{
+    m_arena.reset();
+    m_strings.clear();
+    m_stringLists.clear();
+}
+
+QLatin1String SaveDataView::string(const char *field) const
+{
+    for (const NamedString &string : m_strings) {
+        if (qstrcmp(string.name, field) == 0) {
+            return string.value;
+        }
+    }
+    return QLatin1String();
+}
+
+ArrayView<QLatin1String> SaveDataView::stringList(const char *field) const
+{
+    for (const NamedStringList &list : m_stringLists) {
+        if (qstrcmp(list.name, field) == 0) {
+            return list.value;
+        }
+    }
+    return {};
+}
@@ -0,0 +1,58 @@
+#ifndef SAVEDATAVIEW_H
+#define SAVEDATAVIEW_H
+
+#include "Arena.h"
+#include "SaveFile.h"
+
+#include <QString>
+#include <QVarLengthArray>
+
+// Alternative to the strings in SaveData for going through lots of saves.
+// Strings are views straight into the file when they happen to be byte
+// aligned plain ASCII (so masking them doesn't change anything), otherwise
+// they are copied once into an arena. String lists are flat arrays in the
+// same arena. Nothing is allocated per string, and clear() frees it all.
+class SaveDataView
+{
+public:
+    // Parses the data block of a whole save in place (verifying its checksum
+    // but skipping the header), the file needs to outlive the views
+    bool load(const char *file, const qint64 size);
+
+    void clear();
+
+    QLatin1String saveFileName() const { return string("saveFileName"); }
+    QLatin1String levelName() const { return string("levelName"); }
+    ArrayView<QLatin1String> preloadedBundles() const { return stringList("preloadedBundles"); }
+
+    // By the name in the schema, empty if there's no such field
+    QLatin1String string(const char *field) const;
+    ArrayView<QLatin1String> stringList(const char *field) const;
+
+    // Everything that isn't a string, the strings in it are left empty
+    const SaveData &fields() const { return m_fields; }
+
+    size_t arenaSize() const { return m_arena.bytesAllocated(); }
+
+private:
+    struct Decoder;
+
+    template<QSysInfo::Endian Endian>
+    bool load(const char *file, const qint64 size);
+
+    struct NamedString {
+        const char *name;
+        QLatin1String value;
+    };
+    struct NamedStringList {
+        const char *name;
+        ArrayView<QLatin1String> value;
+    };
+
+    Arena m_arena;
+    SaveData m_fields;
+    QVarLengthArray<NamedString, 4> m_strings;
+    QVarLengthArray<NamedStringList, 2> m_stringLists;
+};
+
+#endif // SAVEDATAVIEW_H
@@ -1,142 +1,928 @@
 #include "SaveFile.h"
+#include "SaveBuffer.h"
+#include "Crc32.h"
+#include "SaveHeaderKeys.h"
+#include "SaveSchema.h"
+#include "SaveTrace.h"
+#include "StringPool.h"
 #include <QDebug>
-#include <QBuffer>
+#include <QFile>
 
-SaveFile::SaveFile(QObject *parent) : QObject(parent)
-{
+#include <algorithm>
+#include <atomic>
+#include <limits>
 
+bool SaveFile::cancelled()
+{
+    if (!m_cancellationFlag || !*m_cancellationFlag) {
+        return false;
+    }
+    qWarning() << "Loading cancelled";
+    m_ok = false;
+    return true;
 }
 
-static inline quint32 calculateCrc32(const QByteArray &data, const quint32 seed)
+quint32 SaveFile::checksum(const Stage stage, const char *data, const qint64 size)
 {
-    quint32 crc32 = ~seed;
-    for (const char &c : data) {
-        quint32 val = (crc32 ^ c) & 0xff;
-        for (int i=0; i<8; i++) {
-            val = (val & 1) ? (val >>1 ) ^ 0xedb88320 : val >> 1;
+    SaveTrace::Span span(m_trace, stage == HeaderChecksum ? "header checksum" : "data checksum");
+    AllocationStats::Scope allocations(&m_allocations[stage]);
+    reportProgress(stage, 0, size);
+
+    if (m_parallelChecksumThreshold >= 0 && size >= m_parallelChecksumThreshold) {
+        const quint32 crc = crc32::calculateParallel(reinterpret_cast<const uchar*>(data), size, 0x12345678);
+        reportProgress(stage, size, size);
+        return crc;
+    }
+
+    // The checksum can be continued from where the last block stopped
+    static constexpr qint64 blockSize = 1024 * 1024;
+    quint32 crc = 0x12345678;
+    for (qint64 offset = 0; offset < size; offset += blockSize) {
+        if (m_cancellationFlag && *m_cancellationFlag) {
+            return 0;
         }
-        crc32 = val ^ (crc32 >> 8);
+        const qint64 length = qMin(blockSize, size - offset);
+        crc = calculateCrc32(data + offset, length, crc);
+        reportProgress(stage, offset + length, size);
     }
+    return crc;
+}
+
+bool SaveFile::load(const QString &path)
+{
+    SaveTrace::Span span(m_trace, "load file", path);
 
-    return ~crc32;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open" << path << file.errorString();
+        return false;
+    }
+    return load(&file);
 }
 
 bool SaveFile::load(QIODevice *input)
 {
     Q_ASSERT(input->isReadable());
-    m_input = input;
+
+    QFile *file = qobject_cast<QFile*>(input);
+    if (file && !file->isSequential() && file->pos() == 0) {
+        const qint64 size = file->size();
+        uchar *mapped = size > 0 ? file->map(0, size) : nullptr;
+        if (mapped) {
+            const bool ret = load(reinterpret_cast<const char*>(mapped), size);
+            file->unmap(mapped);
+            return ret;
+        }
+        qCDebug(lcSaveFile) << "Failed to map file, falling back to reading";
+    }
+
+    const QByteArray data = input->readAll();
+    return load(data.constData(), data.size());
+}
+
+bool SaveFile::load(const char *data, const qint64 size)
+{
+    SaveTrace::Span span(m_trace, "load");
+    m_allocations = {};
+    m_loadAllocations = {};
+    AllocationStats::Scope allocations(&m_loadAllocations);
+
+    setInput(data, size);
 
     m_ok = false;
 
+    m_recordedOffsets.clear();
+    QVector<FieldOffset> *fieldOffsets = m_recordFieldOffsets ? &m_recordedOffsets : nullptr;
+    m_fieldOffsets = fieldOffsets;
+    m_header.m_fieldOffsets = fieldOffsets;
+    m_data.m_fieldOffsets = fieldOffsets;
+
     static constexpr quint64 fileHeader(0x534B4E5548434246); // FBCHUNKS
 
-    const QByteArray magic = input->read(sizeof(quint64));
-    if (magic.size() != sizeof(quint64)) {
+    bool ret = false;
+    recordField("magic");
+    const char *magic = read(sizeof(quint64));
+    if (!magic) {
         qWarning() << "failed to read header";
-        return false;
-    }
-
-    if (qFromLittleEndian<qint64>(magic) == fileHeader) {
-        qDebug() << "little endian";
+    } else if (qFromLittleEndian<quint64>(magic) == fileHeader) {
+        qCDebug(lcSaveFile) << "little endian";
         m_endian = QSysInfo::LittleEndian;
-    } else if (qFromBigEndian<qint64>(magic) == fileHeader) {
-        qDebug() << "big endian";
+        ret = parse<QSysInfo::LittleEndian>();
+    } else if (qFromBigEndian<quint64>(magic) == fileHeader) {
+        qCDebug(lcSaveFile) << "big endian";
         m_endian = QSysInfo::BigEndian;
+        ret = parse<QSysInfo::BigEndian>();
     } else {
-        qWarning() << "Unknown endianness" << magic;
-        return false;
+        qWarning() << "Unknown endianness" << QByteArray(magic, sizeof(quint64));
     }
 
+    releaseInput();
+    return ret;
+}
+
+void SaveFile::releaseInput()
+{
+    // The input is usually unmapped right after loading, and the field
+    // offsets belong to this object, which gets copied and moved around.
+    // m_size and m_position are kept, patch() needs them.
+    Serializable::m_data = nullptr;
+    m_fieldOffsets = nullptr;
+    m_header.m_data = nullptr;
+    m_header.m_fieldOffsets = nullptr;
+    m_data.m_input = nullptr;
+    m_data.m_fieldOffsets = nullptr;
+}
+
+template<QSysInfo::Endian Endian>
+bool SaveFile::parse()
+{
     m_ok = true;
 
-    const quint16 version = read<quint16>();
-    qDebug() << "Version" << version;
+    quint32 headerLength = 0;
+    quint32 dataLength = 0;
+    {
+        SaveTrace::Span span(m_trace, "preamble");
+        AllocationStats::Scope allocations(&m_allocations[Preamble]);
+        reportProgress(Preamble, 0, 1);
+
+        recordField("fileVersion");
+        m_version = read<quint16, Endian>();
+        qCDebug(lcSaveFile) << "Version" << m_version;
+
+        recordField("headerLength");
+        headerLength = read<quint32, Endian>();
+        qCDebug(lcSaveFile) << "header length" << headerLength;
 
-    const quint32 headerLength = read<quint32>();
-    qDebug() << "header length" << headerLength;
+        recordField("dataLength");
+        dataLength = read<quint32, Endian>();
+        qCDebug(lcSaveFile) << "dataLength" << dataLength;
 
-    const quint32 dataLength = read<quint32>();
-    qDebug() << "dataLength" << dataLength;
+        reportProgress(Preamble, 1, 1);
+    }
+    if (cancelled()) {
+        return false;
+    }
 
     { // read header
-        quint32 headerChecksum = read<quint32>();
-        QByteArray header = read(headerLength - sizeof(headerChecksum));
-        const quint32 calculatedHeaderChecksum = calculateCrc32(header, 0x12345678);
+        recordField("headerChecksum");
+        quint32 headerChecksum = read<quint32, Endian>();
+        m_header.m_fieldBase = m_position * 8;
+        const qint64 headerSize = qint64(headerLength) - qint64(sizeof(headerChecksum));
+        const char *header = read(headerSize);
+        if (!header) {
+            qWarning() << "Short read of header" << headerSize;
+            return false;
+        }
+        const quint32 calculatedHeaderChecksum = checksum(HeaderChecksum, header, headerSize);
+        if (cancelled()) {
+            return false;
+        }
         if (headerChecksum != calculatedHeaderChecksum) {
             qWarning() << "Invalid header checksum" << headerChecksum << "expected" << calculatedHeaderChecksum;
             m_ok = false;
             return false;
         }
-        qDebug() << "header checksum correct";
+        qCDebug(lcSaveFile) << "header checksum correct";
+        m_headerChecksum = headerChecksum;
 
-        QBuffer headerBuffer(&header);
-        headerBuffer.open(QIODevice::ReadOnly);
-        if (!m_header.load(&headerBuffer, m_endian)) {
+        SaveTrace::Span span(m_trace, "header");
+        AllocationStats::Scope allocations(&m_allocations[Header]);
+        reportProgress(Header, 0, headerSize);
+        if (!m_header.load<Endian>(header, headerSize)) {
             qWarning() << "Failed to load header";
             m_ok = false;
             return false;
         }
+        if (m_stringPool) {
+            for (SaveHeader::Value &value : m_header.m_values) {
+                m_stringPool->intern(&value.value);
+            }
+        }
+        reportProgress(Header, headerSize, headerSize);
+        if (cancelled()) {
+            return false;
+        }
     }
 
     { // read data
-        quint32 dataChecksum = read<quint32>();
-        qDebug() << "data start" << m_input->pos();
-        QByteArray data = read(dataLength - sizeof(dataChecksum));
-        const quint32 calculatedDataChecksum = calculateCrc32(data, 0x12345678);
+        recordField("dataChecksum");
+        quint32 dataChecksum = read<quint32, Endian>();
+        m_data.m_fieldBase = m_position * 8;
+        qCDebug(lcSaveFile) << "data start" << m_position;
+        const qint64 dataSize = qint64(dataLength) - qint64(sizeof(dataChecksum));
+        const char *data = read(dataSize);
+        if (!data) {
+            qWarning() << "Short read of data" << dataSize;
+            return false;
+        }
+        const quint32 calculatedDataChecksum = checksum(DataChecksum, data, dataSize);
+        if (cancelled()) {
+            return false;
+        }
         if (dataChecksum != calculatedDataChecksum) {
             qWarning() << "Invalid data checksum" << dataChecksum << "expected" << calculatedDataChecksum;
             m_ok = false;
             return false;
         }
-        qDebug() << "data checksum correct";
+        qCDebug(lcSaveFile) << "data checksum correct";
+        m_dataChecksum = dataChecksum;
 
-//        QBuffer dataBuffer(&data);
-//        dataBuffer.open(QIODevice::ReadOnly);
-        bits::bitstream bitstream(reinterpret_cast<quint8*>(data.data()));
-        if (!m_data.load(&bitstream, m_endian)) {
+        SaveTrace::Span span(m_trace, "data");
+        AllocationStats::Scope allocations(&m_allocations[Data]);
+        reportProgress(Data, 0, dataSize);
+        m_data.m_stringPool = m_stringPool;
+        bits::bitreader reader(reinterpret_cast<const uchar*>(data), dataSize);
+        bool loaded = false;
+        if (m_lazyDecoding) {
+            loaded = m_data.loadIndex<Endian>(&reader);
+        } else {
+            loaded = m_data.load<Endian>(&reader);
+        }
+        if (!loaded) {
             qWarning() << "Failed to load data";
             m_ok = false;
             return false;
         }
+        reportProgress(Data, dataSize, dataSize);
     }
 
 
     return m_ok;
 }
 
-bool SaveHeader::load(QIODevice *input, const QSysInfo::Endian endian)
+SaveMetadata SaveFile::scanHeader(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open" << path << file.errorString();
+        return {};
+    }
+    return scanHeader(&file);
+}
+
+bool SaveFile::hasMagic(const char *data, const qint64 size)
+{
+    static constexpr quint64 fileHeader(0x534B4E5548434246); // FBCHUNKS
+    if (size < qint64(sizeof(quint64))) {
+        return false;
+    }
+    return qFromLittleEndian<quint64>(data) == fileHeader || qFromBigEndian<quint64>(data) == fileHeader;
+}
+
+SaveMetadata SaveFile::scanHeader(QIODevice *input)
+{
+    Q_ASSERT(input->isReadable());
+
+    SaveMetadata metadata;
+
+    // magic, version, header length, data length, header checksum
+    static constexpr qint64 preambleSize = sizeof(quint64) + sizeof(quint16) + 3 * sizeof(quint32);
+    const QByteArray preamble = input->read(preambleSize);
+    if (preamble.size() != preambleSize) {
+        qWarning() << "Short read of preamble";
+        return {};
+    }
+
+    static constexpr quint64 fileHeader(0x534B4E5548434246); // FBCHUNKS
+    if (qFromLittleEndian<quint64>(preamble.constData()) == fileHeader) {
+        metadata.endian = QSysInfo::LittleEndian;
+    } else if (qFromBigEndian<quint64>(preamble.constData()) == fileHeader) {
+        metadata.endian = QSysInfo::BigEndian;
+    } else {
+        qWarning() << "Unknown endianness" << preamble.left(sizeof(quint64));
+        return {};
+    }
+
+    Serializable reader;
+    reader.m_endian = metadata.endian;
+    reader.setInput(preamble.constData() + sizeof(quint64), preambleSize - sizeof(quint64));
+    if (metadata.endian == QSysInfo::BigEndian) {
+        metadata.version = reader.read<quint16, QSysInfo::BigEndian>();
+        metadata.headerLength = reader.read<quint32, QSysInfo::BigEndian>();
+        metadata.dataLength = reader.read<quint32, QSysInfo::BigEndian>();
+        metadata.headerChecksum = reader.read<quint32, QSysInfo::BigEndian>();
+    } else {
+        metadata.version = reader.read<quint16, QSysInfo::LittleEndian>();
+        metadata.headerLength = reader.read<quint32, QSysInfo::LittleEndian>();
+        metadata.dataLength = reader.read<quint32, QSysInfo::LittleEndian>();
+        metadata.headerChecksum = reader.read<quint32, QSysInfo::LittleEndian>();
+    }
+
+    if (metadata.headerLength < sizeof(quint32) || metadata.dataLength < sizeof(quint32)) {
+        qWarning() << "Invalid lengths" << metadata.headerLength << metadata.dataLength;
+        return {};
+    }
+
+    // read() allocates what is asked for before reading, so check the length
+    // first. Nothing else tells us how much a sequential device has left, but
+    // real headers are a few hundred bytes.
+    static constexpr qint64 maxSequentialHeaderLength = 1024 * 1024;
+    const qint64 available = input->isSequential() ? maxSequentialHeaderLength : input->size() - input->pos();
+    if (qint64(metadata.headerLength) > available) {
+        qWarning() << "Header length" << metadata.headerLength << "past the end of the file";
+        return {};
+    }
+
+    // The data checksum is the first thing in the data block, so read it while we're here
+    const qint64 headerSize = metadata.headerLength - sizeof(quint32);
+    const QByteArray header = input->read(headerSize + sizeof(quint32));
+    if (header.size() != headerSize + qint64(sizeof(quint32))) {
+        qWarning() << "Short read of header" << header.size();
+        return {};
+    }
+
+    const quint32 calculatedHeaderChecksum = calculateCrc32(header.constData(), headerSize, 0x12345678);
+    if (metadata.headerChecksum != calculatedHeaderChecksum) {
+        qWarning() << "Invalid header checksum" << metadata.headerChecksum << "expected" << calculatedHeaderChecksum;
+        return {};
+    }
+
+    SaveHeader saveHeader;
+    if (!saveHeader.load(header.constData(), headerSize, metadata.endian)) {
+        qWarning() << "Failed to load header";
+        return {};
+    }
+    for (int i=0; i<SaveHeader::NumEntries; i++) {
+        metadata.values[i] = saveHeader.value(SaveHeader::EntryId(i));
+    }
+
+    const char *dataChecksum = header.constData() + headerSize;
+    if (metadata.endian == QSysInfo::BigEndian) {
+        metadata.dataChecksum = qFromBigEndian<quint32>(dataChecksum);
+    } else {
+        metadata.dataChecksum = qFromLittleEndian<quint32>(dataChecksum);
+    }
+
+    if (!input->isSequential()) {
+        const qint64 dataEnd = input->pos() + metadata.dataLength - sizeof(quint32);
+        if (input->size() < dataEnd) {
+            qWarning() << "Truncated data, expected" << dataEnd << "bytes, got" << input->size();
+            return {};
+        }
+        input->seek(dataEnd);
+    }
+
+    metadata.isValid = true;
+    return metadata;
+}
+
+bool SaveFile::save(QIODevice *output)
+{
+    Q_ASSERT(output->isWritable());
+
+    QByteArray data;
+    if (!save(&data)) {
+        return false;
+    }
+    if (output->write(data) != data.size()) {
+        qWarning() << "Failed to write save" << output->errorString();
+        return false;
+    }
+    return true;
+}
+
+bool SaveFile::save(QByteArray *output)
 {
+    if (m_endian == QSysInfo::BigEndian) {
+        return serialize<QSysInfo::BigEndian>(output);
+    } else {
+        return serialize<QSysInfo::LittleEndian>(output);
+    }
+}
+
+template<QSysInfo::Endian Endian>
+bool SaveFile::serialize(QByteArray *output)
+{
+    QByteArray header;
+    const bool headerSaved = m_header.save<Endian>(&header);
+    m_header.m_output = nullptr;
+    if (!headerSaved) {
+        qWarning() << "Failed to write header";
+        return false;
+    }
+
+    bits::bitwriter writer(m_size);
+    const bool dataSaved = m_data.save<Endian>(&writer);
+    m_data.m_output = nullptr;
+    if (!dataSaved) {
+        qWarning() << "Failed to write data";
+        return false;
+    }
+    const std::vector<unsigned char> &data = writer.data();
+
+    const quint32 headerChecksum = calculateCrc32(header.constData(), header.size(), 0x12345678);
+    quint32 dataChecksum = 0;
+    if (m_parallelChecksumThreshold >= 0 && qint64(data.size()) >= m_parallelChecksumThreshold) {
+        dataChecksum = crc32::calculateParallel(data.data(), data.size(), 0x12345678);
+    } else {
+        dataChecksum = crc32::calculate(data.data(), data.size(), 0x12345678);
+    }
+
     m_ok = true;
+    m_output = output;
+    writeChunks<Endian>(m_version, header, headerChecksum,
+                        reinterpret_cast<const char*>(data.data()), qint64(data.size()), dataChecksum);
+    m_output = nullptr;
 
-    m_endian = endian;
-    m_input = input;
+    return m_ok;
+}
+
+const char *SaveFile::fieldAt(const qint64 bitOffset) const
+{
+    // Recorded in file order
+    auto it = std::upper_bound(m_recordedOffsets.constBegin(), m_recordedOffsets.constEnd(), bitOffset,
+            [](const qint64 offset, const FieldOffset &field) {
+        return offset < field.position;
+    });
+    if (it == m_recordedOffsets.constBegin()) {
+        return nullptr;
+    }
+    return (it - 1)->name;
+}
+
+namespace {
+
+std::function<QByteArray(qint64, qint64)> bufferReader(const QByteArray *file)
+{
+    return [file](const qint64 offset, const qint64 length) {
+        return file->mid(offset, length);
+    };
+}
+
+std::function<bool(qint64, const QByteArray&)> bufferWriter(QByteArray *file)
+{
+    return [file](const qint64 offset, const QByteArray &bytes) {
+        file->replace(offset, bytes.size(), bytes);
+        return true;
+    };
+}
+
+std::function<QByteArray(qint64, qint64)> bufferReader(const SaveBuffer *file)
+{
+    return [file](const qint64 offset, const qint64 length) {
+        return file->read(offset, length);
+    };
+}
+
+std::function<bool(qint64, const QByteArray&)> bufferWriter(SaveBuffer *file)
+{
+    return [file](const qint64 offset, const QByteArray &bytes) {
+        return file->write(offset, bytes);
+    };
+}
+
+std::function<QByteArray(qint64, qint64)> deviceReader(QIODevice *file)
+{
+    return [file](const qint64 offset, const qint64 length) {
+        if (!file->seek(offset)) {
+            return QByteArray();
+        }
+        return file->read(length);
+    };
+}
+
+std::function<bool(qint64, const QByteArray&)> deviceWriter(QIODevice *file)
+{
+    return [file](const qint64 offset, const QByteArray &bytes) {
+        if (!file->seek(offset) || file->write(bytes) != bytes.size()) {
+            qWarning() << "Failed to write patch" << file->errorString();
+            return false;
+        }
+        return true;
+    };
+}
+
+} // namespace
+
+bool SaveFile::patch(QByteArray *file, const char *field, const quint64 value)
+{
+    if (file->size() != m_size) {
+        qWarning() << "Patching a different file than was loaded" << file->size() << m_size;
+        return false;
+    }
+    return patch(field, value, bufferReader(file), bufferWriter(file));
+}
+
+bool SaveFile::patch(QByteArray *file, const char *field, const QDateTime &value)
+{
+    if (file->size() != m_size) {
+        qWarning() << "Patching a different file than was loaded" << file->size() << m_size;
+        return false;
+    }
+    return patch(field, value, bufferReader(file), bufferWriter(file));
+}
+
+bool SaveFile::patch(SaveBuffer *file, const char *field, const quint64 value)
+{
+    if (file->size() != m_size) {
+        qWarning() << "Patching a different file than was loaded" << file->size() << m_size;
+        return false;
+    }
+    return patch(field, value, bufferReader(file), bufferWriter(file));
+}
+
+bool SaveFile::patch(SaveBuffer *file, const char *field, const QDateTime &value)
+{
+    if (file->size() != m_size) {
+        qWarning() << "Patching a different file than was loaded" << file->size() << m_size;
+        return false;
+    }
+    return patch(field, value, bufferReader(file), bufferWriter(file));
+}
+
+bool SaveFile::patch(QIODevice *file, const char *field, const quint64 value)
+{
+    Q_ASSERT(file->isReadable() && file->isWritable() && !file->isSequential());
+
+    if (file->size() != m_size) {
+        qWarning() << "Patching a different file than was loaded" << file->size() << m_size;
+        return false;
+    }
+    return patch(field, value, deviceReader(file), deviceWriter(file));
+}
+
+bool SaveFile::patch(QIODevice *file, const char *field, const QDateTime &value)
+{
+    Q_ASSERT(file->isReadable() && file->isWritable() && !file->isSequential());
+
+    if (file->size() != m_size) {
+        qWarning() << "Patching a different file than was loaded" << file->size() << m_size;
+        return false;
+    }
+    return patch(field, value, deviceReader(file), deviceWriter(file));
+}
+
+template<typename Value>
+bool SaveFile::patch(const char *field, const Value &value, const ByteReader &readBytes, const ByteWriter &writeBytes)
+{
+    if (m_endian == QSysInfo::BigEndian) {
+        return patch<QSysInfo::BigEndian>(field, value, readBytes, writeBytes);
+    } else {
+        return patch<QSysInfo::LittleEndian>(field, value, readBytes, writeBytes);
+    }
+}
+
+template<QSysInfo::Endian Endian, typename Value>
+bool SaveFile::patch(const char *field, const Value &value, const ByteReader &readBytes, const ByteWriter &writeBytes)
+{
+    if (!m_ok) {
+        qWarning() << "Can't patch a save that failed to load";
+        return false;
+    }
+
+    // These decide how the rest is parsed, or if it can be loaded at all
+    static const char *const layoutFields[] = { "entryCount", "gameVersion", "saveVersion" };
+    for (const char *layoutField : layoutFields) {
+        if (qstrcmp(field, layoutField) == 0) {
+            qWarning() << "Can't patch" << field << "without changing the layout of the save";
+            return false;
+        }
+    }
+
+    auto offset = std::find_if(m_recordedOffsets.constBegin(), m_recordedOffsets.constEnd(), [field](const FieldOffset &recorded) {
+        return qstrcmp(recorded.name, field) == 0;
+    });
+    if (offset == m_recordedOffsets.constEnd()) {
+        qWarning() << "No recorded offset for" << field << "(load with setRecordFieldOffsets(true))";
+        return false;
+    }
+
+    // Encode the new value the same way as when saving. Only the fields whose
+    // size doesn't depend on the value can be patched.
+    QByteArray encoded;
+    qint64 numBits = 0;
+    std::function<void()> apply;
+    const auto encode = [&](auto &object, const auto &descriptor, auto *output) {
+        using Descriptor = std::decay_t<decltype(descriptor)>;
+        using Member = std::decay_t<decltype(object.*descriptor.member)>;
+        if constexpr (Descriptor::Codec::fixedWidth && std::is_convertible<Value, Member>::value) {
+            const Member member = Member(value);
+            if constexpr (std::is_integral<Member>::value) {
+                if (quint64(member) != value) {
+                    qWarning() << "Value" << value << "doesn't fit in" << field;
+                    return;
+                }
+            } else {
+                if (!member.isValid() || quint64(member.toSecsSinceEpoch()) > std::numeric_limits<quint32>::max()) {
+                    qWarning() << "Timestamp" << member << "doesn't fit in" << field;
+                    return;
+                }
+            }
+            object.m_output = output;
+            Descriptor::Codec::template write<Endian>(object, member);
+            object.m_output = nullptr;
+            apply = [&object, pointer = descriptor.member, member]() { object.*pointer = member; };
+        } else {
+            qWarning() << field << "is not a fixed width field of the right type";
+        }
+    };
+
+    if (offset->position >= m_data.m_fieldBase) {
+        bits::bitwriter writer(sizeof(quint64));
+        const auto encodeData = [&](const auto &descriptor) { encode(m_data, descriptor, &writer); };
+        if (!schema::forField(schema::saveDataPrefix, field, encodeData)) {
+            schema::forField(schema::saveDataBody, field, encodeData);
+        }
+        numBits = writer.position();
+        const std::vector<unsigned char> &data = writer.data();
+        encoded = QByteArray(reinterpret_cast<const char*>(data.data()), int(data.size()));
+    } else if (offset->position >= m_header.m_fieldBase) {
+        schema::forField(schema::headerPreamble, field, [&](const auto &descriptor) {
+            encode(m_header, descriptor, &encoded);
+        });
+        numBits = encoded.size() * 8;
+    }
+    if (!apply) {
+        qWarning() << "Can't patch" << field;
+        return false;
+    }
 
+    // The block the field is in, and where its checksum is
+    const bool inData = offset->position >= m_data.m_fieldBase;
+    const qint64 blockStart = (inData ? m_data.m_fieldBase : m_header.m_fieldBase) / 8;
+    const qint64 blockEnd = inData ? m_position : m_data.m_fieldBase / 8 - qint64(sizeof(quint32)); // m_position is still at the end of the data after loading
+    const qint64 checksumOffset = blockStart - qint64(sizeof(quint32));
+
+    const qint64 first = offset->position / 8;
+    const qint64 last = (offset->position + numBits - 1) / 8;
+    Q_ASSERT(first >= blockStart && last < blockEnd);
+
+    const QByteArray original = readBytes(first, last - first + 1);
+    const QByteArray storedChecksum = readBytes(checksumOffset, sizeof(quint32));
+    if (original.size() != last - first + 1 || storedChecksum.size() != sizeof(quint32)) {
+        qWarning() << "Short read when patching" << field;
+        return false;
+    }
+
+    // The field doesn't have to start on a byte boundary in the data, bits are MSB first
+    QByteArray difference(original.size(), 0);
+    for (qint64 bit = 0; bit < numBits; bit++) {
+        const qint64 position = offset->position + bit - first * 8;
+        const bool newBit = quint8(encoded[int(bit / 8)]) & (0x80 >> (bit % 8));
+        const bool oldBit = quint8(original[int(position / 8)]) & (0x80 >> (position % 8));
+        if (newBit != oldBit) {
+            difference[int(position / 8)] = char(difference[int(position / 8)] | (0x80 >> (position % 8)));
+        }
+    }
+
+    QByteArray patched = original;
+    for (int i=0; i<patched.size(); i++) {
+        patched[i] = char(patched[i] ^ difference[i]);
+    }
+
+    quint32 checksum = 0;
+    if constexpr (Endian == QSysInfo::BigEndian) {
+        checksum = qFromBigEndian<quint32>(storedChecksum.constData());
+    } else {
+        checksum = qFromLittleEndian<quint32>(storedChecksum.constData());
+    }
+    checksum ^= crc32::update(reinterpret_cast<const uchar*>(difference.constData()), difference.size(), blockEnd - last - 1);
+
+    QByteArray checksumBytes(sizeof(quint32), Qt::Uninitialized);
+    if constexpr (Endian == QSysInfo::BigEndian) {
+        qToBigEndian<quint32>(checksum, checksumBytes.data());
+    } else {
+        qToLittleEndian<quint32>(checksum, checksumBytes.data());
+    }
+
+    if (!writeBytes(first, patched) || !writeBytes(checksumOffset, checksumBytes)) {
+        return false;
+    }
+    apply();
+    if (inData) {
+        m_dataChecksum = checksum;
+    } else {
+        m_headerChecksum = checksum;
+    }
+    return true;
+}
+
+bool SaveFile::undo(SaveBuffer *file)
+{
+    if (file->size() != m_size) {
+        qWarning() << "Undoing in a different file than was loaded" << file->size() << m_size;
+        return false;
+    }
+    if (!file->undo()) {
+        return false;
+    }
+    return reloadPatchable(bufferReader(file));
+}
+
+bool SaveFile::redo(SaveBuffer *file)
+{
+    if (file->size() != m_size) {
+        qWarning() << "Redoing in a different file than was loaded" << file->size() << m_size;
+        return false;
+    }
+    if (!file->redo()) {
+        return false;
+    }
+    return reloadPatchable(bufferReader(file));
+}
+
+bool SaveFile::reloadPatchable(const ByteReader &readBytes)
+{
+    if (m_endian == QSysInfo::BigEndian) {
+        return reloadPatchable<QSysInfo::BigEndian>(readBytes);
+    } else {
+        return reloadPatchable<QSysInfo::LittleEndian>(readBytes);
+    }
+}
+
+template<QSysInfo::Endian Endian>
+bool SaveFile::reloadPatchable(const ByteReader &readBytes)
+{
+    if (!m_ok) {
+        return false;
+    }
+
+    // Same fields as patch() looks for, the rest can't have changed
+    bool ok = true;
+    for (const FieldOffset &offset : m_recordedOffsets) {
+        const bool inData = offset.position >= m_data.m_fieldBase;
+        if (!inData && offset.position < m_header.m_fieldBase) {
+            continue;
+        }
+        const qint64 first = offset.position / 8;
+        const qint64 blockEnd = inData ? m_position : m_data.m_fieldBase / 8 - qint64(sizeof(quint32));
+        const QByteArray bytes = readBytes(first, qMin<qint64>(sizeof(quint64) + 1, blockEnd - first));
+
+        const auto decode = [&](auto &object, const auto &descriptor, auto &io) {
+            using Descriptor = std::decay_t<decltype(descriptor)>;
+            if constexpr (Descriptor::Codec::fixedWidth) {
+                Descriptor::Codec::template read<Endian>(io, object.*descriptor.member);
+                ok = ok && io.m_ok;
+            }
+        };
+        if (inData) {
+            bits::bitreader reader(reinterpret_cast<const uchar*>(bytes.constData()), bytes.size());
+            reader.seek(unsigned(offset.position - first * 8));
+            BaseSave io;
+            io.m_input = &reader;
+            const auto decodeData = [&](const auto &descriptor) { decode(m_data, descriptor, io); };
+            if (!schema::forField(schema::saveDataPrefix, offset.name, decodeData)) {
+                schema::forField(schema::saveDataBody, offset.name, decodeData);
+            }
+            ok = ok && !reader.overrun();
+        } else {
+            Serializable io;
+            io.setInput(bytes.constData(), bytes.size());
+            schema::forField(schema::headerPreamble, offset.name, [&](const auto &descriptor) {
+                decode(m_header, descriptor, io);
+            });
+        }
+    }
+
+    const QByteArray headerChecksum = readBytes(m_header.m_fieldBase / 8 - qint64(sizeof(quint32)), sizeof(quint32));
+    const QByteArray dataChecksum = readBytes(m_data.m_fieldBase / 8 - qint64(sizeof(quint32)), sizeof(quint32));
+    if (headerChecksum.size() != sizeof(quint32) || dataChecksum.size() != sizeof(quint32)) {
+        ok = false;
+    } else if constexpr (Endian == QSysInfo::BigEndian) {
+        m_headerChecksum = qFromBigEndian<quint32>(headerChecksum.constData());
+        m_dataChecksum = qFromBigEndian<quint32>(dataChecksum.constData());
+    } else {
+        m_headerChecksum = qFromLittleEndian<quint32>(headerChecksum.constData());
+        m_dataChecksum = qFromLittleEndian<quint32>(dataChecksum.constData());
+    }
+
+    if (!ok) {
+        qWarning() << "Failed to read the patched fields back";
+    }
+    return ok;
+}
+
+quint32 SaveHeader::keyHash(const EntryId id)
+{
+    Q_ASSERT(id >= 0 && id < NumEntries);
+    return headerkeys::hashes[id];
+}
+
+const char *SaveHeader::keyName(const EntryId id)
+{
+    Q_ASSERT(id >= 0 && id < NumEntries);
+    return headerkeys::names[id];
+}
+
+const QString &SaveHeader::value(const EntryId id) const
+{
+    static const QString missing;
+    const int index = m_entryIndex[id] - 1;
+    if (index < 0 || index >= m_values.count()) {
+        return missing;
+    }
+    return m_values[index].value;
+}
+
+void SaveHeader::indexEntries()
+{
+    m_entryIndex.fill(0);
+    m_unknownEntries = 0;
+    m_entriesReordered = false;
+    m_keyedByPosition = false;
+
+    for (int i=0; i<m_values.count(); i++) {
+        const int id = headerkeys::entryId(m_values[i].hash);
+        if (id < 0 || m_entryIndex[id]) { // duplicates count as unknown
+            m_unknownEntries++;
+            continue;
+        }
+        m_entryIndex[id] = qint8(i + 1);
+        if (id != i) {
+            m_entriesReordered = true;
+        }
+    }
+
+    if (m_values.count() && m_unknownEntries == m_values.count()) {
+        // Means our guess at the hash function is wrong, which would be the
+        // same for every file, so only warn about the first one
+        static std::atomic<bool> warned(false);
+        if (!warned.exchange(true)) {
+            qCWarning(lcSaveHeader) << "None of the header entry hashes are known, assuming the usual order."
+                                    << "Unknown or reordered entries can't be detected.";
+        }
+        qCDebug(lcSaveHeader) << "Header entries keyed by position";
+        m_keyedByPosition = true;
+        m_unknownEntries = 0;
+        for (int i=0; i<m_values.count() && i<NumEntries; i++) {
+            m_entryIndex[i] = qint8(i + 1);
+        }
+        return;
+    }
+    if (m_unknownEntries) {
+        qCDebug(lcSaveHeader) << "Unknown header entries:" << m_unknownEntries;
+    }
+    if (m_entriesReordered) {
+        qCDebug(lcSaveHeader) << "Header entries are not in the usual order";
+    }
+}
+
+bool SaveHeader::load(const char *data, const qint64 size, const QSysInfo::Endian endian)
+{
+    if (endian == QSysInfo::BigEndian) {
+        return load<QSysInfo::BigEndian>(data, size);
+    } else {
+        return load<QSysInfo::LittleEndian>(data, size);
+    }
+}
+
+template<QSysInfo::Endian Endian>
+bool SaveHeader::load(const char *data, const qint64 size)
+{
+    m_ok = true;
+
+    m_endian = Endian;
+    setInput(data, size);
+
+    recordField("headerMagic");
     if (!readMagic("FBHEADER")) {
         return false;
     }
 
-    const quint16 version = read<quint16>();
-    qDebug() << "Header version" << version;
+    if (!schema::read<Endian>(*this, schema::headerPreamble)) {
+        return false;
+    }
+    qCDebug(lcSaveHeader) << "Header version" << m_version;
 
-    const quint32 entryCount = read<quint32>();
-    if (entryCount != NumEntries) {
-        qWarning() << "Invalid number of entries" << entryCount << "expected" << NumEntries;
+    if (m_entryCount != NumEntries) {
+        qWarning() << "Invalid number of entries" << m_entryCount << "expected" << NumEntries;
         m_ok = false;
         return false;
     }
-    qDebug() << "entry count" << entryCount;
-    m_values.resize(entryCount);
-    for (Value &entry : m_values) {
-        entry.hash = read<quint32>();
-//        const quint16 entryLength = read<quint16>();
-//        entry.value = QString::fromUtf8(read(entryLength));
-        entry.value = readString();
-        qDebug() << entry.value;
+    qCDebug(lcSaveHeader) << "entry count" << m_entryCount;
+    m_values.resize(m_entryCount);
+
+    if (!schema::read<Endian>(*this, schema::headerEntries)) {
+        return false;
+    }
+    indexEntries();
+    return true;
+}
+
+bool SaveHeader::save(QByteArray *output, const QSysInfo::Endian endian)
+{
+    if (endian == QSysInfo::BigEndian) {
+        return save<QSysInfo::BigEndian>(output);
+    } else {
+        return save<QSysInfo::LittleEndian>(output);
     }
+}
 
-    return m_ok;
+template<QSysInfo::Endian Endian>
+bool SaveHeader::save(QByteArray *output)
+{
+    m_ok = true;
+
+    m_endian = Endian;
+    m_output = output;
+
+    writeMagic("FBHEADER");
+
+    m_entryCount = m_values.count();
+    return schema::write<Endian>(*this, schema::headerPreamble) && schema::write<Endian>(*this, schema::headerEntries);
 }
 
+template<QSysInfo::Endian Endian>
 bool BaseSave::load()
 {
     Q_ASSERT(m_input);
@@ -145,78 +931,274 @@ bool BaseSave::load()
 
 //    if (!readMagic("FB\0SAVE\n")) {
 //    if (!readMagic(qToBigEndian<quint64>(0x0A45564153004246ul))) {
-    if (!readMagic(qToLittleEndian<quint64>(0x0A45564153004246ul))) {
+    recordField("dataMagic");
+    if (!readMagic<Endian>(qToLittleEndian<quint64>(0x0A45564153004246ul))) {
         return false;
     }
 
-    m_hasUnknown = m_input->read<quint8>(4);
-    if (m_hasUnknown) {
-        qDebug() << "Skipped";
-        m_input->skip(27);
+    schema::read<Endian>(*this, schema::baseSave);
+    m_hasUnknown = m_unknownFlags;
+
+    return m_ok;
+}
+
+// Also used by SaveDataView
+template bool BaseSave::load<QSysInfo::LittleEndian>();
+template bool BaseSave::load<QSysInfo::BigEndian>();
+
+template<QSysInfo::Endian Endian>
+bool BaseSave::save()
+{
+    Q_ASSERT(m_output);
+
+    m_ok = true;
+
+    writeMagic<Endian>(qToLittleEndian<quint64>(0x0A45564153004246ul));
+
+    return schema::write<Endian>(*this, schema::baseSave);
+}
+
+bool SaveData::load(bits::bitreader *input, const QSysInfo::Endian endian)
+{
+    if (endian == QSysInfo::BigEndian) {
+        return load<QSysInfo::BigEndian>(input);
+    } else {
+        return load<QSysInfo::LittleEndian>(input);
     }
+}
+
+template<QSysInfo::Endian Endian>
+bool SaveData::load(bits::bitreader *input)
+{
+    m_endian = Endian;
+    m_input = input;
 
+    m_lazyFields.clear();
+    m_lazyData.clear();
 
-    return m_ok;
+    return parse<Endian, false>();
+}
+
+bool SaveData::loadIndex(bits::bitreader *input, const QSysInfo::Endian endian)
+{
+    if (endian == QSysInfo::BigEndian) {
+        return loadIndex<QSysInfo::BigEndian>(input);
+    } else {
+        return loadIndex<QSysInfo::LittleEndian>(input);
+    }
 }
 
-bool SaveData::load(bits::bitstream *input, const QSysInfo::Endian endian)
+template<QSysInfo::Endian Endian>
+bool SaveData::loadIndex(bits::bitreader *input)
 {
-    m_endian = endian;
+    m_endian = Endian;
     m_input = input;
 
-    if (!BaseSave::load()) {
+    m_lazyFields.clear();
+    m_lazyData.clear();
+    m_lazyDataStart = 0;
+
+    const bool ret = parse<Endian, true>();
+    if (!ret || m_lazyFields.isEmpty()) {
+        m_lazyFields.clear();
+        m_stringPool = nullptr;
+        return ret;
+    }
+
+    // The input goes away after loading, so keep the bytes from the first
+    // string up to the remainder, and make the offsets relative to them
+    m_lazyDataStart = m_lazyFields.first().position / 8;
+    const qint64 end = (qint64(m_input->size()) * 8 - m_remainderBits + 7) / 8;
+    m_lazyData = QByteArray(reinterpret_cast<const char*>(m_input->ptr()) + m_lazyDataStart, int(end - m_lazyDataStart));
+    for (FieldOffset &field : m_lazyFields) {
+        field.position -= m_lazyDataStart * 8;
+    }
+
+    return ret;
+}
+
+template<QSysInfo::Endian Endian, bool Lazy>
+bool SaveData::parse()
+{
+    if (!BaseSave::load<Endian>()) {
         return false;
     }
-//    m_input->skip(30);
-    qDebug() << "Has unknown?" << m_hasUnknown;
+    qCDebug(lcSaveData) << "Has unknown?" << m_hasUnknown;
 
-    // TODO: gibbed's code reads 64 bits here, but there's just 32 until the string starts
-    const quint64 rawTimestamp = read<quint32>();
-    qDebug() << "raw timestamp" << rawTimestamp;
-    m_timestamp = QDateTime::fromSecsSinceEpoch(rawTimestamp);
-    qDebug() << "timestamp" << m_timestamp;
-    qDebug() << qFromBigEndian<quint32>(rawTimestamp)<< qFromLittleEndian<quint64>(rawTimestamp);
+    const auto readFields = [this](const auto &fields, auto version) {
+        if constexpr (Lazy) {
+            return schema::index<Endian, decltype(version)::value>(*this, fields);
+        } else {
+            return schema::read<Endian, decltype(version)::value>(*this, fields);
+        }
+    };
 
+    if (!readFields(schema::saveDataPrefix, std::integral_constant<quint16, 0>())) {
+        return false;
+    }
+    qCDebug(lcSaveData) << "timestamp" << m_timestamp;
+    qCDebug(lcSaveData) << "save file name" << m_saveFileName;
 
-    m_saveFileName = readString();
-    qDebug() << m_saveFileName << m_saveFileName.length();
+    const bool supportedVersion = schema::forSaveVersion(m_saveVersion, [&](auto version) {
+        readFields(schema::saveDataBody, version);
+    });
+    if (!supportedVersion) {
+        qWarning() << "unsupported save version" << m_saveVersion;
+        m_ok = false;
+        return false;
+    }
 
-    m_gameVersion = read<quint16>();
+    // Checked after the rest is read, the fields stop at the first failure
     if (m_gameVersion != 3) {
         qWarning() << "unsupported game version" << m_gameVersion;
         m_ok = false;
 //        return false;
     }
-    m_saveVersion = read<quint16>();
-    if (m_saveVersion < 20 || m_saveVersion > 22) {
-        qWarning() << "unsupported save version" << m_saveVersion;
+
+    qCDebug(lcSaveData) << "game version" << m_gameVersion;
+    qCDebug(lcSaveData) << "save version" << m_saveVersion;
+    qCDebug(lcSaveData) << "unknown1" << m_unknown1;
+    qCDebug(lcSaveData) << "unknown2" << m_unknown2;
+    qCDebug(lcSaveData) << "user build info" << m_userBuildInfo;
+    qCDebug(lcSaveData) << "level name" << m_levelName << "probably related unknown:" << m_unknown3;
+    qCDebug(lcSaveData) << "preloaded bundles" << m_preloadedBundles;
+
+    if (m_input->overrun()) {
+        qWarning() << "Read past the end of the data";
         m_ok = false;
         return false;
     }
 
-    m_unknown1 = read<quint16>();
-    m_unknown2 = read<quint16>();
-    m_userBuildInfo = read<quint32>();
-
-    qDebug() << "game version" << m_gameVersion;
-    qDebug() << "save version" << m_saveVersion;
-    qDebug() << "unknown1" << m_unknown1;
-    qDebug() << "unknown2" << m_unknown2;
-    qDebug() << "user build info" << m_unknown2;
-
-    m_levelName = readString();
-    m_unknown3 = read<quint32>();
-    qDebug() << "level name" << m_levelName << "probably related unknown:" << m_unknown3;
-    if (1){
-        const size_t size = 200;
+#ifndef QT_NO_DEBUG_OUTPUT
+    if (lcSaveData().isDebugEnabled()) { // start of what we don't parse yet
+        const size_t size = qMin<size_t>(200, (m_input->size() * 8 - m_input->position()) / 8);
         std::string data(size, 0);
         m_input->peekstring(reinterpret_cast<quint8*>(data.data()), size * 8);
-        qDebug() << QByteArray::fromStdString(data);
-        qDebug() << QByteArray::fromStdString(data).toHex(':');
-//        return false;
+        qCDebug(lcSaveData) << QByteArray::fromStdString(data);
+        qCDebug(lcSaveData) << QByteArray::fromStdString(data).toHex(':');
+    }
+#endif
+
+    // Copied even when lazy, decoding it would be the same copy later
+    recordField("remainder");
+    m_remainderBits = qint64(m_input->size()) * 8 - m_input->position();
+    m_remainder = QByteArray((m_remainderBits + 7) / 8, 0);
+    m_input->readstring(reinterpret_cast<quint8*>(m_remainder.data()), m_remainderBits);
+    if constexpr (!Lazy) {
+        internStrings();
+        m_stringPool = nullptr;
+    }
+
+    return m_ok;
+}
+
+void SaveData::decode(const char *name) const
+{
+    if (m_lazyFields.isEmpty()) {
+        return;
+    }
+    if (m_endian == QSysInfo::BigEndian) {
+        decode<QSysInfo::BigEndian>(name);
+    } else {
+        decode<QSysInfo::LittleEndian>(name);
+    }
+}
+
+template<QSysInfo::Endian Endian>
+void SaveData::decode(const char *name) const
+{
+    auto lazyField = std::find_if(m_lazyFields.begin(), m_lazyFields.end(), [name](const FieldOffset &field) {
+        return qstrcmp(field.name, name) == 0;
+    });
+    if (lazyField == m_lazyFields.end()) {
+        return;
+    }
+
+    bits::bitreader reader(reinterpret_cast<const uchar*>(m_lazyData.constData()), m_lazyData.size());
+    reader.seek(unsigned(lazyField->position));
+    m_lazyFields.erase(lazyField);
+
+    // Only the members that haven't been decoded yet are changed, so the
+    // object stays the same from the outside
+    SaveData *self = const_cast<SaveData*>(this);
+
+    BaseSave io;
+    io.m_endian = Endian;
+    io.m_input = &reader;
+    const auto decodeField = [&](const auto &field) {
+        auto &member = self->*field.member;
+        std::decay_t<decltype(field)>::Codec::template read<Endian>(io, member);
+        if (!io.m_ok || reader.overrun()) {
+            // Got through it once when indexing, so the copy doesn't match
+            qWarning() << "Failed to decode" << name;
+            member = std::decay_t<decltype(member)>();
+            self->m_ok = false;
+        }
+    };
+    if (!schema::forField(schema::saveDataPrefix, name, decodeField)) {
+        schema::forField(schema::saveDataBody, name, decodeField);
+    }
+    internStrings();
+
+    if (m_lazyFields.isEmpty()) {
+        m_lazyData.clear();
+        self->m_stringPool = nullptr;
+    }
+}
+
+void SaveData::internStrings() const
+{
+    if (!m_stringPool) {
+        return;
+    }
+    // Only the ones that repeat between saves, the file name is different in all of them
+    SaveData *self = const_cast<SaveData*>(this);
+    m_stringPool->intern(&self->m_levelName);
+    m_stringPool->intern(&self->m_preloadedBundles);
+}
+
+void SaveData::decodeAll() const
+{
+    while (!m_lazyFields.isEmpty()) {
+        decode(m_lazyFields.first().name);
+    }
+}
+
+bool SaveData::save(bits::bitwriter *output, const QSysInfo::Endian endian)
+{
+    if (endian == QSysInfo::BigEndian) {
+        return save<QSysInfo::BigEndian>(output);
+    } else {
+        return save<QSysInfo::LittleEndian>(output);
+    }
+}
+
+template<QSysInfo::Endian Endian>
+bool SaveData::save(bits::bitwriter *output)
+{
+    decodeAll();
+
+    m_endian = Endian;
+    m_output = output;
+
+    if (!BaseSave::save<Endian>()) {
+        return false;
+    }
+
+    if (!schema::write<Endian>(*this, schema::saveDataPrefix)) {
+        return false;
+    }
+
+    const bool supportedVersion = schema::forSaveVersion(m_saveVersion, [this](auto version) {
+        schema::write<Endian, decltype(version)::value>(*this, schema::saveDataBody);
+    });
+    if (!supportedVersion) {
+        qWarning() << "unsupported save version" << m_saveVersion;
+        m_ok = false;
+        return false;
     }
 
-    m_preloadedBundles = readStringList();
+    m_output->writestring(m_remainderBits, reinterpret_cast<const quint8*>(m_remainder.constData()));
 
     return m_ok;
 }
@@ -1,17 +1,27 @@
 #ifndef SAVEFILE_H
 #define SAVEFILE_H
 
-#include <QObject>
 #include <QtEndian>
 #include <QIODevice>
 #include <QHash>
+#include <QVector>
 #include <QMetaEnum>
 #include <QDebug>
 #include <QDateTime>
 
-#include "bits/bits-stream.h"
+#include <array>
+#include <atomic>
+#include <functional>
+
+#include "bits/bits-reader.h"
+#include "bits/bits-writer.h"
+#include "AllocationStats.h"
+#include "SaveLog.h"
 
 class QIODevice;
+class SaveBuffer;
+class SaveTrace;
+class StringPool;
 
 template <typename ENUM> static QString enumToString(const ENUM val) {
     static_assert(std::is_enum<ENUM>());
@@ -25,75 +35,142 @@ template <typename ENUM> static QString enumFromString(const QString &string, bo
 
 }
 
+// Where a field starts, in bits from the start of the file
+struct FieldOffset
+{
+    const char *name;
+    qint64 position;
+};
+
 struct Serializable
 {
-protected:
-    QByteArray read(const qint64 size) {
-        QByteArray data = m_input->read(size);
-        if (data.size() != size) {
+    // Returns a pointer straight into the input, nothing is copied
+    const char *read(const qint64 size) {
+        if (size < 0 || size > m_size - m_position) {
             m_ok = false;
-            return {};
-        }
-
-        if (m_endian == QSysInfo::BigEndian) {
-            qFromBigEndian<char>(data.constData(), data.size(), data.data());
-        } else {
-            qFromLittleEndian<char>(data.constData(), data.size(), data.data());
-        }
-        for (int i=0; i<data.count(); i++) {
-            data[i] = data[i];
+            return nullptr;
         }
+        const char *data = m_data + m_position;
+        m_position += size;
         return data;
     }
 
-    template<typename T>
+    // Endianness is fixed once we've seen the magic, so it's a template
+    // argument instead of something to check on every read
+    template<typename T, QSysInfo::Endian Endian>
     T read() {
-        QByteArray data = m_input->read(sizeof(T));
-        if (data.size() != sizeof(T)) {
-            m_ok = false;
+        const char *data = read(sizeof(T));
+        if (!data) {
             return {};
         }
 
-        if (m_endian == QSysInfo::BigEndian) {
+        if constexpr (Endian == QSysInfo::BigEndian) {
             return qFromBigEndian<T>(data);
         } else {
             return qFromLittleEndian<T>(data);
         }
     }
 
+    template<QSysInfo::Endian Endian>
     QString readString() {
-        const quint16 length = read<quint16>();
+        const quint16 length = read<quint16, Endian>();
         if (length > 1000) { //arbitrary
             qWarning() << "Unrealistically long string" << length;
             m_ok = false;
             return {};
         }
-        return QString::fromUtf8(read(length));
+        const char *data = read(length);
+        if (!data) {
+            return {};
+        }
+        return QString::fromUtf8(data, length);
     }
 
     bool readMagic(const char *raw) {
-        const QByteArray expected(raw, sizeof(quint64));
-        const QByteArray magic = read(expected.size());
-        if (magic.length() != sizeof(quint64)) {
-            qWarning() << "short read of magic" << magic.size();
-            m_ok = false;
-        }
-        if (!m_ok) {
+        const QByteArray expected = QByteArray::fromRawData(raw, sizeof(quint64));
+        const char *data = read(expected.size());
+        if (!data) {
+            qWarning() << "short read of magic";
             return false;
         }
+        const QByteArray magic = QByteArray::fromRawData(data, expected.size());
         if (magic != expected) {
             qWarning() << "Invalid magic" << magic << "expected" << expected;
             m_ok = false;
             return false;
         }
-        qDebug() << "magic vlaid" << magic << expected;
         return true;
     }
 
+    void setInput(const char *data, const qint64 size) {
+        m_data = data;
+        m_size = size;
+        m_position = 0;
+    }
+
+    // Counterparts of the read functions above, appending to m_output
+    template<typename T, QSysInfo::Endian Endian>
+    void write(const T value) {
+        char data[sizeof(T)];
+        if constexpr (Endian == QSysInfo::BigEndian) {
+            qToBigEndian<T>(value, data);
+        } else {
+            qToLittleEndian<T>(value, data);
+        }
+        m_output->append(data, sizeof(T));
+    }
+
+    template<QSysInfo::Endian Endian>
+    void writeString(const QString &string) {
+        const QByteArray data = string.toUtf8();
+        if (data.size() > 1000) { // same limit as when reading
+            qWarning() << "Unrealistically long string" << data.size();
+            m_ok = false;
+            return;
+        }
+        write<quint16, Endian>(data.size());
+        m_output->append(data);
+    }
+
+    void writeMagic(const char *raw) {
+        m_output->append(raw, sizeof(quint64));
+    }
+
+    // Replaces m_output with a whole file, around header and data blocks
+    // that are already serialized
+    template<QSysInfo::Endian Endian>
+    void writeChunks(const quint16 version, const QByteArray &header, const quint32 headerChecksum,
+                     const char *data, const qint64 dataSize, const quint32 dataChecksum) {
+        m_output->clear();
+        m_output->reserve(sizeof(quint64) + sizeof(quint16) + 4 * sizeof(quint32) + header.size() + int(dataSize));
+        write<quint64, Endian>(0x534B4E5548434246); // FBCHUNKS
+        write<quint16, Endian>(version);
+        write<quint32, Endian>(header.size() + sizeof(quint32));
+        write<quint32, Endian>(dataSize + sizeof(quint32));
+        write<quint32, Endian>(headerChecksum);
+        m_output->append(header);
+        write<quint32, Endian>(dataChecksum);
+        m_output->append(data, int(dataSize));
+    }
+
+    void recordField(const char *name) {
+        if (m_fieldOffsets) {
+            m_fieldOffsets->append({name, m_fieldBase + m_position * 8});
+        }
+    }
+
     QSysInfo::Endian m_endian;
     bool m_ok = true;
 
-    QIODevice *m_input = nullptr;
+    const char *m_data = nullptr;
+    qint64 m_size = 0;
+    qint64 m_position = 0;
+
+    QByteArray *m_output = nullptr;
+
+    // Only set when the field offsets are wanted, m_fieldBase is where the input starts in the file
+    QVector<FieldOffset> *m_fieldOffsets = nullptr;
+    qint64 m_fieldBase = 0;
 };
 
 struct SaveHeader : public Serializable
@@ -101,7 +178,15 @@ struct SaveHeader : public Serializable
     Q_GADGET
 
 public:
-    bool load(QIODevice *input, const QSysInfo::Endian endian);
+    bool load(const char *data, const qint64 size, const QSysInfo::Endian endian);
+
+    template<QSysInfo::Endian Endian>
+    bool load(const char *data, const qint64 size);
+
+    bool save(QByteArray *output, const QSysInfo::Endian endian);
+
+    template<QSysInfo::Endian Endian>
+    bool save(QByteArray *output);
 
     enum EntryId {
         AreaNameStringId = 0,
@@ -128,57 +213,93 @@ public:
     };
     Q_ENUM(EntryId) // can convert to and from string
 
+    // What we assume the hash in front of each value is: FNV-1 of the key
+    // name. Used when creating headers from scratch and to recognize the
+    // entries when loading, the file keeps whatever hashes it has.
+    static quint32 keyHash(const EntryId id);
+
+    // Without going through QMetaEnum
+    static const char *keyName(const EntryId id);
+
+    // Looked up by the hash, so it doesn't matter where the entry is.
+    // Empty if the header doesn't have it.
+    template<EntryId Id>
+    const QString &get() const {
+        static_assert(Id >= 0 && Id < NumEntries, "not a header entry");
+        return value(Id);
+    }
+    const QString &value(const EntryId id) const;
+
     struct Value {
         quint32 hash;
         QString value;
     };
 
+    quint16 m_version = 0;
+    quint32 m_entryCount = 0;
     QVector<Value> m_values; // list to preserve ordering
+
+    // Where each entry is in m_values plus one, 0 if missing. Found from the
+    // hashes when loading; if none of them are known (so our guess of how
+    // they're hashed is wrong for this file) the entries are assumed to be in
+    // order, and m_keyedByPosition is set. Unknown and reordered entries can't
+    // be detected then, so m_unknownEntries and m_entriesReordered stay unset.
+    std::array<qint8, NumEntries> m_entryIndex = {};
+    int m_unknownEntries = 0;
+    bool m_entriesReordered = false;
+    bool m_keyedByPosition = false;
+
+private:
+    void indexEntries();
+};
+
+// What a save browser needs, read without touching the data block
+struct SaveMetadata
+{
+    QString value(const SaveHeader::EntryId id) const { return values[id]; }
+
+    bool isValid = false;
+    QSysInfo::Endian endian = QSysInfo::LittleEndian;
+    quint16 version = 0;
+    quint32 headerLength = 0;
+    quint32 dataLength = 0;
+    quint32 headerChecksum = 0;
+    quint32 dataChecksum = 0; // not verified
+
+    std::array<QString, SaveHeader::NumEntries> values; // indexed by SaveHeader::EntryId
 };
 
 struct BaseSave
 {
+    template<QSysInfo::Endian Endian>
     bool load();
 
-    QByteArray read(const quint64 size) {
-        std::string data(size, 0);
-        m_input->readstring(reinterpret_cast<quint8*>(data.data()), size * 8);
-        if (data.size() != size) {
-            m_ok = false;
-            return {};
-        }
-
-//        if (m_endian == QSysInfo::BigEndian) {
-//            qFromBigEndian<char>(data.data(), data.size(), data.data());
-//        } else {
-//            qFromLittleEndian<char>(data.data(), data.size(), data.data());
-//        }
-        return QByteArray::fromStdString(data);
-    }
+    template<QSysInfo::Endian Endian>
+    bool save();
 
-    template<typename T,
-             std::enable_if_t<std::is_same<T, bool>::value, int> = 0
-             >
-    T read() {
-        return m_input->read<quint8>(1);
+    QByteArray read(const quint64 size) {
+        QByteArray data(size, Qt::Uninitialized);
+        m_input->readbytes(reinterpret_cast<quint8*>(data.data()), size);
+        return data;
     }
 
-    template<typename T,
-             std::enable_if_t<std::negation<std::is_same<T, bool>>::value, int> = 0
-             >
+    template<typename T, QSysInfo::Endian Endian>
     T read() {
-        T data = m_input->read<T>(sizeof(T) * 8);
-//        return data;
-        if (m_endian == QSysInfo::LittleEndian) { // bitstream swaps under us?
-            return qFromBigEndian<T>(data);
+        if constexpr (std::is_same<T, bool>::value) {
+            return m_input->read<quint8>(1);
         } else {
-            return qFromLittleEndian<T>(data);
+            T data = m_input->read<T>(sizeof(T) * 8);
+            if constexpr (Endian == QSysInfo::LittleEndian) { // bitstream swaps under us?
+                return qFromBigEndian<T>(data);
+            } else {
+                return qFromLittleEndian<T>(data);
+            }
         }
     }
 
+    template<QSysInfo::Endian Endian>
     QString readString() {
-        const quint16 length = read<quint16>();
-        qDebug() << "String length" << length;
+        const quint16 length = read<quint16, Endian>();
         if (length == 0) {
             return {};
         }
@@ -187,50 +308,70 @@ struct BaseSave
             m_ok = false;
             return {};
         }
-        QByteArray content =read(length);
-        for (char &c : content) {
-            c &= 0x7f; // wtffff
-        }
-        qDebug() << content;
-        qDebug() << content.toHex(':');
-        return QString::fromUtf8(content, length);
-//        return QString::fromUtf8(read(length), length);
+        // Everything gets masked down to 7 bits, so decoding as Latin-1 is the same as UTF-8
+        QString ret(length, Qt::Uninitialized);
+        m_input->readwide(reinterpret_cast<quint16*>(ret.data()), length, 0x7f); // wtffff
+        qCDebug(lcSaveData) << "String" << ret;
+        return ret;
     }
 
+    template<QSysInfo::Endian Endian>
     QStringList readStringList() {
-        const quint16 length = read<quint16>();
-        qDebug() << "String list length:" << length;
+        const quint16 length = read<quint16, Endian>();
+        qCDebug(lcSaveData) << "String list length:" << length;
 
         QStringList ret;
         for (int i=0; i<length; i++) {
-            ret.append(readString());
+            ret.append(readString<Endian>());
             if (!m_ok) {
-                qDebug() << ret;
+                qCDebug(lcSaveData) << "Failed after" << ret;
                 return {};
             }
         }
         return ret;
     }
+    // For finding where things are without decoding them
+    template<QSysInfo::Endian Endian>
+    void skipString() {
+        const quint16 length = read<quint16, Endian>();
+        if (length > 1000) { // same as readString()
+            qWarning() << "Unrealistically long string" << length;
+            m_ok = false;
+            return;
+        }
+        m_input->skip(length * 8);
+    }
+
+    template<QSysInfo::Endian Endian>
+    void skipStringList() {
+        const quint16 length = read<quint16, Endian>();
+        for (int i=0; i<length && m_ok; i++) {
+            skipString<Endian>();
+        }
+    }
+
+    template<QSysInfo::Endian Endian>
     QHash<QString, QString> readDictionary() {
-        const quint16 length = read<quint16>();
+        const quint16 length = read<quint16, Endian>();
 
         QHash<QString, QString> ret;
         for (int i=0; i<length; i++) {
-            QString key = readString();
+            QString key = readString<Endian>();
             if (!m_ok) {
                 return {};
             }
-            QString value = readString();
+            QString value = readString<Endian>();
             if (!m_ok) {
                 return {};
             }
-            qDebug() << key << value;
+            qCDebug(lcSaveData) << key << value;
             ret.insert(key, value);
         }
         return ret;
     }
 
 //    bool readMagic(const char *raw) {
+    template<QSysInfo::Endian Endian>
     bool readMagic(const quint64 expected) {
 //        const QByteArray expected(raw, sizeof(quint64));
 //        const QByteArray magic = read(expected.size());
@@ -241,24 +382,84 @@ struct BaseSave
 //        if (!m_ok) {
 //            return false;
 //        }
-        const quint64 magic = read<quint64>();
+        const quint64 magic = read<quint64, Endian>();
 //        const quint64 expected = 0x0A45564153004246ul;
         if (magic != expected) {
             qWarning() << "Invalid magic" << magic << "expected" << expected;
             m_ok = false;
             return false;
         }
-//        qDebug() << "magic vlaid" << magic << expected;
         return true;
     }
 
+    // Counterparts of the read functions above
+    void write(const QByteArray &data) {
+        m_output->writebytes(reinterpret_cast<const quint8*>(data.constData()), data.size());
+    }
+
+    template<typename T, QSysInfo::Endian Endian>
+    void write(const T value) {
+        if constexpr (std::is_same<T, bool>::value) {
+            m_output->write<quint8>(1, value);
+        } else if constexpr (Endian == QSysInfo::LittleEndian) {
+            m_output->write<T>(sizeof(T) * 8, qToBigEndian<T>(value));
+        } else {
+            m_output->write<T>(sizeof(T) * 8, qToLittleEndian<T>(value));
+        }
+    }
+
+    template<QSysInfo::Endian Endian>
+    void writeString(const QString &string) {
+        if (string.length() > 1000) { // same limit as when reading
+            qWarning() << "Unrealistically long string" << string.length();
+            m_ok = false;
+            return;
+        }
+        write<quint16, Endian>(string.length());
+        write(string.toLatin1());
+    }
+
+    template<QSysInfo::Endian Endian>
+    void writeStringList(const QStringList &list) {
+        write<quint16, Endian>(list.count());
+        for (const QString &string : list) {
+            writeString<Endian>(string);
+        }
+    }
+
+    template<QSysInfo::Endian Endian>
+    void writeDictionary(const QHash<QString, QString> &dictionary) {
+        write<quint16, Endian>(dictionary.count());
+        for (auto it = dictionary.constBegin(); it != dictionary.constEnd(); ++it) {
+            writeString<Endian>(it.key());
+            writeString<Endian>(it.value());
+        }
+    }
+
+    template<QSysInfo::Endian Endian>
+    void writeMagic(const quint64 magic) {
+        write<quint64, Endian>(magic);
+    }
+
+    void recordField(const char *name) {
+        if (m_fieldOffsets) {
+            m_fieldOffsets->append({name, m_fieldBase + m_input->position()});
+        }
+    }
+
     QSysInfo::Endian m_endian;
     bool m_ok = true;
 
     bool m_hasUnknown = false;
+    quint8 m_unknownFlags = 0;
+    quint32 m_unknownBits = 0;
     quint32 m_unknown[27];
 
-    bits::bitstream *m_input = nullptr;
+    bits::bitreader *m_input = nullptr;
+    bits::bitwriter *m_output = nullptr;
+
+    QVector<FieldOffset> *m_fieldOffsets = nullptr;
+    qint64 m_fieldBase = 0;
 };
 
 struct SaveData : public BaseSave
@@ -266,7 +467,42 @@ struct SaveData : public BaseSave
     Q_GADGET
 
 public:
-    bool load(bits::bitstream *input, const QSysInfo::Endian endian);
+    bool load(bits::bitreader *input, const QSysInfo::Endian endian);
+
+    template<QSysInfo::Endian Endian>
+    bool load(bits::bitreader *input);
+
+    // Lazy alternative to load(), only reads the fixed width fields and the
+    // remainder, and finds where the strings are. The accessors below decode
+    // the strings on first use, from a copy of just the bytes they're in.
+    bool loadIndex(bits::bitreader *input, const QSysInfo::Endian endian);
+
+    template<QSysInfo::Endian Endian>
+    bool loadIndex(bits::bitreader *input);
+
+    bool save(bits::bitwriter *output, const QSysInfo::Endian endian);
+
+    template<QSysInfo::Endian Endian>
+    bool save(bits::bitwriter *output);
+
+    // Work after both load() and loadIndex(). Decoding on first use changes
+    // the object, so don't call them from several threads at once before
+    // decodeAll() has been called.
+    const QString &saveFileName() const { decode("saveFileName"); return m_saveFileName; }
+    const QString &levelName() const { decode("levelName"); return m_levelName; }
+    const QStringList &preloadedBundles() const { decode("preloadedBundles"); return m_preloadedBundles; }
+    const QByteArray &remainder() const { decode("remainder"); return m_remainder; }
+
+    // Makes the members valid without going through the accessors, and drops the copy of the data
+    void decodeAll() const;
+
+    void recordLazyField(const char *name) {
+        m_lazyFields.append({name, qint64(m_input->position())});
+    }
+
+    // Level name and preloaded bundles are taken from here if set, when
+    // decoded. Cleared once there's nothing left to decode.
+    StringPool *m_stringPool = nullptr;
 
     QDateTime m_timestamp;
     QString m_saveFileName;
@@ -280,21 +516,182 @@ public:
     QString m_levelName;
 
     QStringList m_preloadedBundles;
+
+    // Everything after what we know how to parse, written back verbatim
+    QByteArray m_remainder;
+    qint64 m_remainderBits = 0;
+
+private:
+    void decode(const char *name) const;
+    void internStrings() const;
+
+    template<QSysInfo::Endian Endian>
+    void decode(const char *name) const;
+
+    template<QSysInfo::Endian Endian, bool Lazy>
+    bool parse();
+
+    // Not decoded yet, with offsets in bits into m_lazyData, which starts
+    // m_lazyDataStart bytes into the data block
+    mutable QVector<FieldOffset> m_lazyFields;
+    mutable QByteArray m_lazyData;
+    qint64 m_lazyDataStart = 0;
 };
 
 
-class SaveFile : public QObject, public Serializable
+// A plain value, cheap to move around and keep lots of. Use SaveLoader for
+// loading in another thread with signals for progress.
+class SaveFile : private Serializable
 {
-    Q_OBJECT
+    Q_GADGET
 
 public:
-    explicit SaveFile(QObject *parent = nullptr);
+    enum Stage {
+        Preamble,
+        HeaderChecksum,
+        Header,
+        DataChecksum,
+        Data,
+        NumStages
+    };
+    Q_ENUM(Stage)
 
-    bool load(QIODevice *input);
+    // Called from the thread calling load(), done == total when a stage is finished
+    using ProgressCallback = std::function<void(Stage stage, qint64 done, qint64 total)>;
 
-signals:
+    // Maps the file if possible, otherwise reads it in one go
+    bool load(QIODevice *input);
+    bool load(const QString &path);
+
+    // Parses in place, data needs to stay valid until this returns
+    bool load(const char *data, const qint64 size);
+
+    // Writes the whole file again, in the endianness it was loaded with
+    bool save(QByteArray *output);
+    bool save(QIODevice *output);
+
+    const SaveHeader &header() const { return m_header; }
+    const SaveData &data() const { return m_data; }
+
+    // As stored in the file, both verified by load()
+    quint32 headerChecksum() const { return m_headerChecksum; }
+    quint32 dataChecksum() const { return m_dataChecksum; }
+
+    // Only reads the preamble and the header (verifying the header checksum) and seeks past the data
+    static SaveMetadata scanHeader(QIODevice *input);
+    static SaveMetadata scanHeader(const QString &path);
+
+    // If data starts with the magic of a save, in either byte order. Needs at least 8 bytes.
+    static bool hasMagic(const char *data, const qint64 size);
+
+    // Data blocks of at least this many bytes get checksummed in parallel, negative to disable
+    void setParallelChecksumThreshold(const qint64 bytes) { m_parallelChecksumThreshold = bytes; }
+
+    void setProgressCallback(ProgressCallback callback) { m_progressCallback = std::move(callback); }
+
+    // load() returns false as soon as possible after the flag is set from
+    // another thread, the flag needs to outlive the load
+    void setCancellationFlag(const std::atomic<bool> *cancelled) { m_cancellationFlag = cancelled; }
+
+    // Only decode the strings in the data block when they're asked for, see
+    // SaveData::loadIndex(). Off by default.
+    void setLazyDecoding(const bool lazy) { m_lazyDecoding = lazy; }
+
+    // Shares the strings that repeat between saves with other saves using the
+    // same pool. The pool needs to outlive the loads, and with lazy decoding
+    // also this object and its copies, until they have decoded everything
+    // (see SaveData::decodeAll()). They don't use it after that.
+    void setStringPool(StringPool *pool) { m_stringPool = pool; }
+
+    // Adds a span for each stage of the loads to the trace, the trace needs
+    // to outlive the loads
+    void setTrace(SaveTrace *trace) { m_trace = trace; }
+
+    // Heap use of each stage of the last load, and of the whole load. Only
+    // counted while AllocationStats is enabled, zero otherwise.
+    const AllocationStats::Counters &allocations(const Stage stage) const { return m_allocations[stage]; }
+    const AllocationStats::Counters &loadAllocations() const { return m_loadAllocations; }
+
+    // Records where every field starts when loading, off by default
+    void setRecordFieldOffsets(const bool record) { m_recordFieldOffsets = record; }
+    const QVector<FieldOffset> &fieldOffsets() const { return m_recordedOffsets; }
+
+    // Name of the field containing the bit at offset, needs the field offsets
+    const char *fieldAt(const qint64 bitOffset) const;
+
+    // Changes a fixed width field (the integers and the timestamp) in the
+    // file this was loaded from, which needs the field offsets. Only the bytes
+    // holding the field and the checksum in front of the block are rewritten,
+    // the checksum is updated from what changed instead of hashing the whole
+    // block again. The file on the device is edited in place.
+    bool patch(QByteArray *file, const char *field, const quint64 value);
+    bool patch(QByteArray *file, const char *field, const QDateTime &value);
+    bool patch(SaveBuffer *file, const char *field, const quint64 value);
+    bool patch(SaveBuffer *file, const char *field, const QDateTime &value);
+    bool patch(QIODevice *file, const char *field, const quint64 value);
+    bool patch(QIODevice *file, const char *field, const QDateTime &value);
+
+    // Undoes or redoes a step in file, and reads the patchable fields and the
+    // checksums back from it so they match the file again. Calling undo() on
+    // the buffer directly leaves the patched values here as they were.
+    bool undo(SaveBuffer *file);
+    bool redo(SaveBuffer *file);
 
 private:
+    template<QSysInfo::Endian Endian>
+    bool parse();
+
+    template<QSysInfo::Endian Endian>
+    bool serialize(QByteArray *output);
+
+    void reportProgress(const Stage stage, const qint64 done, const qint64 total) {
+        if (m_progressCallback) {
+            m_progressCallback(stage, done, total);
+        }
+    }
+
+    // Access to the file being patched, offsets are in bytes from the start
+    using ByteReader = std::function<QByteArray(qint64 offset, qint64 length)>;
+    using ByteWriter = std::function<bool(qint64 offset, const QByteArray &bytes)>;
+
+    template<typename Value>
+    bool patch(const char *field, const Value &value, const ByteReader &readBytes, const ByteWriter &writeBytes);
+
+    template<QSysInfo::Endian Endian, typename Value>
+    bool patch(const char *field, const Value &value, const ByteReader &readBytes, const ByteWriter &writeBytes);
+
+    // Reads what patch() can change from the file again
+    bool reloadPatchable(const ByteReader &readBytes);
+
+    template<QSysInfo::Endian Endian>
+    bool reloadPatchable(const ByteReader &readBytes);
+
+    // Checks for cancellation and reports progress between blocks when
+    // checksumming serially
+    quint32 checksum(const Stage stage, const char *data, const qint64 size);
+
+    // Clears the pointers into the input and into this object after loading
+    void releaseInput();
+    bool cancelled();
+
+    qint64 m_parallelChecksumThreshold = 4 * 1024 * 1024;
+    ProgressCallback m_progressCallback;
+    const std::atomic<bool> *m_cancellationFlag = nullptr;
+
+    bool m_lazyDecoding = false;
+    StringPool *m_stringPool = nullptr;
+    SaveTrace *m_trace = nullptr;
+
+    std::array<AllocationStats::Counters, NumStages> m_allocations = {};
+    AllocationStats::Counters m_loadAllocations;
+
+    bool m_recordFieldOffsets = false;
+    QVector<FieldOffset> m_recordedOffsets;
+
+    quint16 m_version = 0;
+    quint32 m_headerChecksum = 0;
+    quint32 m_dataChecksum = 0;
+
     SaveHeader m_header;
     SaveData m_data;
 };
@@ -0,0 +1,141 @@
+#include "SaveGenerator.h"
+
+#include "SaveFile.h"
+#include "Crc32.h"
+
+namespace {
+
+// splitmix64, fast and good enough to fill megabytes of noise
+class Random
+{
+public:
+    explicit Random(const quint64 seed) : m_state(seed) {}
+
+    quint64 next() {
+        quint64 z = (m_state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    int bounded(const int minimum, const int maximum) {
+        if (maximum <= minimum) {
+            return minimum;
+        }
+        return minimum + int(next() % quint64(maximum - minimum + 1));
+    }
+
+    // Printable ASCII, so it survives the 7 bit masking in the data block
+    QString string(const int length) {
+        QString ret(length, Qt::Uninitialized);
+        for (int i=0; i<length; i++) {
+            ret[i] = QChar(' ' + int(next() % 95));
+        }
+        return ret;
+    }
+
+    void fill(char *data, const qint64 size) {
+        qint64 i = 0;
+        for (; i + 8 <= size; i += 8) {
+            const quint64 value = next();
+            memcpy(data + i, &value, sizeof(value));
+        }
+        if (i < size) {
+            const quint64 value = next();
+            memcpy(data + i, &value, size - i);
+        }
+    }
+
+private:
+    quint64 m_state;
+};
+
+QString headerValue(const SaveHeader::EntryId id, Random &random)
+{
+    switch (id) {
+    case SaveHeader::GameVersion:
+        return QStringLiteral("3");
+    case SaveHeader::PlayerLevel:
+        return QString::number(random.bounded(1, 72));
+    case SaveHeader::GameCompleted:
+    case SaveHeader::TrialMode:
+        return QString::number(random.bounded(0, 1));
+    case SaveHeader::CompletionPercentage:
+        return QString::number(random.bounded(0, 100));
+    case SaveHeader::DateTime:
+    case SaveHeader::TotalPlaytime:
+        return QString::number(1489000000 + random.bounded(0, 100000000));
+    default:
+        return random.string(random.bounded(0, 48));
+    }
+}
+
+} // namespace
+
+quint64 SaveGenerator::fileSeed(const quint64 seed, const quint64 index)
+{
+    Random random(seed ^ (index * 0xd1b54a32d192ed03ull));
+    return random.next();
+}
+
+QByteArray SaveGenerator::generate(const Options &options, const quint64 seed)
+{
+    Random random(seed);
+    const QSysInfo::Endian endian = options.endian;
+
+    SaveHeader header;
+    header.m_version = 1;
+    for (int i=0; i<SaveHeader::NumEntries; i++) {
+        const SaveHeader::EntryId id = SaveHeader::EntryId(i);
+        header.m_values.append({SaveHeader::keyHash(id), headerValue(id, random)});
+    }
+    QByteArray headerData;
+    if (!header.save(&headerData, endian)) {
+        qWarning() << "Failed to generate header";
+        return {};
+    }
+
+    SaveData data;
+    data.m_unknownFlags = random.bounded(0, 1) ? random.bounded(1, 15) : 0;
+    data.m_unknownBits = data.m_unknownFlags ? quint32(random.next() & 0x7ffffff) : 0;
+    data.m_timestamp = QDateTime::fromSecsSinceEpoch(1489000000 + random.bounded(0, 100000000));
+    data.m_saveFileName = QString::asprintf("Career%08x-%dAutoSave", quint32(random.next()), random.bounded(0, 9));
+    data.m_gameVersion = 3;
+    data.m_saveVersion = random.bounded(20, 22);
+    data.m_unknown1 = random.next();
+    data.m_unknown2 = random.next();
+    data.m_unknown3 = random.next();
+    data.m_userBuildInfo = random.next();
+    data.m_levelName = "levels/" + random.string(random.bounded(1, 64));
+    const int maxBundleLength = qMin(options.maxBundleLength, 1000);
+    for (int i=0; i<options.bundleCount; i++) {
+        data.m_preloadedBundles.append(random.string(random.bounded(options.minBundleLength, maxBundleLength)));
+    }
+
+    // Don't end on a byte boundary either
+    data.m_remainder = QByteArray(options.remainderSize, Qt::Uninitialized);
+    random.fill(data.m_remainder.data(), data.m_remainder.size());
+    data.m_remainderBits = options.remainderSize * 8 - (options.remainderSize > 0 ? random.bounded(0, 7) : 0);
+
+    bits::bitwriter writer(options.remainderSize + 64 * 1024);
+    if (!data.save(&writer, endian)) {
+        qWarning() << "Failed to generate data";
+        return {};
+    }
+    const std::vector<unsigned char> &written = writer.data();
+
+    const quint32 headerChecksum = calculateCrc32(headerData.constData(), headerData.size(), 0x12345678);
+    const quint32 dataChecksum = calculateCrc32(reinterpret_cast<const char*>(written.data()), written.size(), 0x12345678);
+
+    QByteArray file;
+    Serializable output;
+    output.m_output = &file;
+    const char *dataBlock = reinterpret_cast<const char*>(written.data());
+    if (endian == QSysInfo::BigEndian) {
+        output.writeChunks<QSysInfo::BigEndian>(1, headerData, headerChecksum, dataBlock, qint64(written.size()), dataChecksum);
+    } else {
+        output.writeChunks<QSysInfo::LittleEndian>(1, headerData, headerChecksum, dataBlock, qint64(written.size()), dataChecksum);
+    }
+
+    return file;
+}
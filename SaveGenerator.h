@@ -0,0 +1,34 @@
+#ifndef SAVEGENERATOR_H
+#define SAVEGENERATOR_H
+
+#include <QByteArray>
+#include <QtGlobal>
+#include <QSysInfo>
+
+// Creates saves with a valid structure and valid checksums, so we can test
+// and benchmark without real saves from the game. The same options and seed
+// always give the same file.
+class SaveGenerator
+{
+public:
+    struct Options {
+        QSysInfo::Endian endian = QSysInfo::LittleEndian;
+
+        int bundleCount = 64;
+        int minBundleLength = 8;
+        int maxBundleLength = 64; // at most 1000, like everything else
+
+        // Random bytes after what we parse, most of a real save is this
+        qint64 remainderSize = 2 * 1024 * 1024;
+    };
+
+    // The flags that decide if there are 4 or 31 bits before the timestamp,
+    // the string lengths and the number of bits at the end are all picked
+    // from the seed, so the fields land on all kinds of bit offsets.
+    static QByteArray generate(const Options &options, const quint64 seed);
+
+    // Mixes the corpus seed and a file number into the seed of that file
+    static quint64 fileSeed(const quint64 seed, const quint64 index);
+};
+
+#endif // SAVEGENERATOR_H
@@ -0,0 +1,152 @@
+#ifndef SAVEHEADERKEYS_H
+#define SAVEHEADERKEYS_H
+
+#include "SaveFile.h"
+
+#include <array>
+
+// The header entry keys and their hashes, and a perfect hash from the key
+// hashes back to SaveHeader::EntryId. All of it is computed at compile time,
+// so recognizing an entry while parsing is a multiply, a shift and a compare.
+namespace headerkeys {
+
+// Same order as SaveHeader::EntryId
+inline constexpr std::array<const char*, SaveHeader::NumEntries> names = {
+    "AreaNameStringId",
+    "AreaThumbnailTextureId",
+    "GameVersion",
+    "RequiredDLC",
+    "RequiredInstallGroup",
+    "ProfileName",
+    "ProfileUniqueName",
+    "ProfileId",
+    "LevelID",
+    "PlayerLevel",
+    "GameCompleted",
+    "TrialMode",
+    "CompletionPercentage",
+    "DateTime",
+    "LevelTitleID",
+    "LevelFloorID",
+    "LevelRegionID",
+    "TotalPlaytime",
+    "NameOverrideStringId",
+};
+
+constexpr bool equal(const char *a, const char *b)
+{
+    for (; *a && *a == *b; a++, b++) {}
+    return *a == *b;
+}
+
+// Q_ENUM needs the enumerators spelled out, so check each name against them instead
+#define HEADERKEYS_CHECK_NAME(id) \
+    static_assert(equal(names[SaveHeader::id], #id), "headerkeys::names doesn't match SaveHeader::EntryId");
+HEADERKEYS_CHECK_NAME(AreaNameStringId)
+HEADERKEYS_CHECK_NAME(AreaThumbnailTextureId)
+HEADERKEYS_CHECK_NAME(GameVersion)
+HEADERKEYS_CHECK_NAME(RequiredDLC)
+HEADERKEYS_CHECK_NAME(RequiredInstallGroup)
+HEADERKEYS_CHECK_NAME(ProfileName)
+HEADERKEYS_CHECK_NAME(ProfileUniqueName)
+HEADERKEYS_CHECK_NAME(ProfileId)
+HEADERKEYS_CHECK_NAME(LevelID)
+HEADERKEYS_CHECK_NAME(PlayerLevel)
+HEADERKEYS_CHECK_NAME(GameCompleted)
+HEADERKEYS_CHECK_NAME(TrialMode)
+HEADERKEYS_CHECK_NAME(CompletionPercentage)
+HEADERKEYS_CHECK_NAME(DateTime)
+HEADERKEYS_CHECK_NAME(LevelTitleID)
+HEADERKEYS_CHECK_NAME(LevelFloorID)
+HEADERKEYS_CHECK_NAME(LevelRegionID)
+HEADERKEYS_CHECK_NAME(TotalPlaytime)
+HEADERKEYS_CHECK_NAME(NameOverrideStringId)
+static_assert(SaveHeader::NameOverrideStringId + 1 == SaveHeader::NumEntries, "new EntryId needs a name and a check above");
+#undef HEADERKEYS_CHECK_NAME
+
+// What we assume the hash in front of each value is. Not checked against
+// saves from the game yet (SaveGenerator writes the same guess), if it's
+// wrong the entries are keyed by position, see SaveHeader::m_keyedByPosition.
+constexpr quint32 fnv1(const char *string)
+{
+    quint32 hash = 0x811c9dc5;
+    for (; *string; string++) {
+        hash = (hash * 0x01000193) ^ quint8(*string);
+    }
+    return hash;
+}
+
+constexpr std::array<quint32, SaveHeader::NumEntries> computeHashes()
+{
+    std::array<quint32, SaveHeader::NumEntries> hashes = {};
+    for (size_t i=0; i<names.size(); i++) {
+        hashes[i] = fnv1(names[i]);
+    }
+    return hashes;
+}
+
+inline constexpr std::array<quint32, SaveHeader::NumEntries> hashes = computeHashes();
+
+// slot = (hash * multiplier) >> (32 - bits), with the first multiplier
+// that doesn't put two keys in the same slot
+struct PerfectHash {
+    quint32 multiplier;
+    int bits;
+};
+
+constexpr quint32 slot(const quint32 hash, const PerfectHash &perfectHash)
+{
+    return quint32(hash * perfectHash.multiplier) >> (32 - perfectHash.bits);
+}
+
+constexpr PerfectHash findPerfectHash()
+{
+    for (int bits = 5; bits <= 8; bits++) {
+        for (quint32 attempt = 0; attempt < 4096; attempt++) {
+            const PerfectHash candidate{0x9e3779b1 + 2 * attempt, bits};
+            bool used[1 << 8] = {};
+            bool collision = false;
+            for (const quint32 hash : hashes) {
+                const quint32 index = slot(hash, candidate);
+                collision = collision || used[index];
+                used[index] = true;
+            }
+            if (!collision) {
+                return candidate;
+            }
+        }
+    }
+    return {0, 0};
+}
+
+inline constexpr PerfectHash perfectHash = findPerfectHash();
+static_assert(perfectHash.bits != 0, "no perfect hash found for the header keys");
+
+// EntryId for each slot, -1 for the empty ones
+constexpr std::array<qint8, (1 << perfectHash.bits)> computeTable()
+{
+    std::array<qint8, (1 << perfectHash.bits)> table = {};
+    for (qint8 &id : table) {
+        id = -1;
+    }
+    for (size_t i=0; i<hashes.size(); i++) {
+        table[slot(hashes[i], perfectHash)] = qint8(i);
+    }
+    return table;
+}
+
+inline constexpr std::array<qint8, (1 << perfectHash.bits)> table = computeTable();
+
+// -1 if it's not the hash of a key we know
+constexpr int entryId(const quint32 hash)
+{
+    const int id = table[slot(hash, perfectHash)];
+    return id >= 0 && hashes[id] == hash ? id : -1;
+}
+
+static_assert(entryId(fnv1("PlayerLevel")) == SaveHeader::PlayerLevel, "perfect hash is broken");
+static_assert(entryId(fnv1("NameOverrideStringId")) == SaveHeader::NameOverrideStringId, "perfect hash is broken");
+
+} // namespace headerkeys
+
+#endif // SAVEHEADERKEYS_H
@@ -0,0 +1,192 @@
+#include "SaveIndex.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtConcurrent>
+
+#include <functional>
+
+static constexpr quint64 s_indexMagic = 0x5845444E4941454D; // MEAINDEX
+static constexpr quint32 s_indexVersion = 1;
+
+static QDataStream &operator<<(QDataStream &stream, const SaveIndex::Entry &entry)
+{
+    stream << entry.path << entry.size << entry.modified << entry.headerChecksum << entry.dataChecksum;
+    stream << entry.isValid << entry.headerValues;
+    stream << entry.timestamp << entry.saveFileName << entry.gameVersion << entry.saveVersion << entry.levelName;
+    return stream;
+}
+
+static QDataStream &operator>>(QDataStream &stream, SaveIndex::Entry &entry)
+{
+    stream >> entry.path >> entry.size >> entry.modified >> entry.headerChecksum >> entry.dataChecksum;
+    stream >> entry.isValid >> entry.headerValues;
+    stream >> entry.timestamp >> entry.saveFileName >> entry.gameVersion >> entry.saveVersion >> entry.levelName;
+    return stream;
+}
+
+QString SaveIndex::defaultIndexPath(const QString &directory)
+{
+    return QDir(directory).filePath(".save-index");
+}
+
+bool SaveIndex::load(const QString &indexPath)
+{
+    m_entries.clear();
+    m_stringPool.clear();
+
+    QFile file(indexPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "No index at" << indexPath;
+        return false;
+    }
+
+    // Read it in one go, instead of lots of small reads through the stream
+    const QByteArray contents = file.readAll();
+    QDataStream stream(contents);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint64 magic = 0;
+    quint32 version = 0, count = 0;
+    stream >> magic >> version >> count;
+    if (magic != s_indexMagic || version != s_indexVersion) {
+        qWarning() << "Invalid or outdated index" << indexPath;
+        return false;
+    }
+
+    // Every entry takes more than a byte, so don't trust a count that couldn't fit
+    if (count > quint32(contents.size())) {
+        qWarning() << "Corrupt index" << indexPath << "claims" << count << "entries";
+        return false;
+    }
+
+    m_entries.reserve(int(count));
+    for (quint32 i=0; i<count; i++) {
+        Entry entry;
+        stream >> entry;
+        if (stream.status() != QDataStream::Ok) {
+            qWarning() << "Corrupt index" << indexPath;
+            m_entries.clear();
+            return false;
+        }
+        intern(&entry);
+        m_entries.insert(entry.path, entry);
+    }
+
+    return true;
+}
+
+bool SaveIndex::save(const QString &indexPath) const
+{
+    QSaveFile file(indexPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open" << indexPath << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << s_indexMagic << s_indexVersion << quint32(m_entries.count());
+    for (const Entry &entry : m_entries) {
+        stream << entry;
+    }
+
+    return file.commit();
+}
+
+int SaveIndex::update(const QString &directory)
+{
+    const QString indexName = QFileInfo(defaultIndexPath(directory)).fileName();
+
+    QHash<QString, Entry> updated;
+    QStringList changed;
+
+    const QFileInfoList files = QDir(directory).entryInfoList(QDir::Files, QDir::Name);
+    for (const QFileInfo &info : files) {
+        if (info.fileName() == indexName) {
+            continue;
+        }
+        const QString path = info.absoluteFilePath();
+        const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+
+        auto it = m_entries.constFind(path);
+        if (it != m_entries.constEnd() && it->size == info.size()) {
+            if (it->modified == modified) {
+                updated.insert(path, *it);
+                continue;
+            }
+
+            // Might just have been touched, the checksums are cheap to check
+            const SaveMetadata metadata = SaveFile::scanHeader(path);
+            if (metadata.isValid && metadata.headerChecksum == it->headerChecksum && metadata.dataChecksum == it->dataChecksum) {
+                Entry entry = *it;
+                entry.modified = modified;
+                updated.insert(path, entry);
+                continue;
+            }
+        }
+
+        changed.append(path);
+    }
+
+    StringPool *stringPool = &m_stringPool;
+    const std::function<Entry(const QString&)> parse = [stringPool](const QString &path) {
+        return SaveIndex::parse(path, stringPool);
+    };
+    const QVector<Entry> parsed = QtConcurrent::blockingMapped<QVector<Entry>>(changed, parse);
+    for (const Entry &entry : parsed) {
+        updated.insert(entry.path, entry);
+    }
+
+    // Also drops the ones that have been deleted
+    m_entries = updated;
+
+    return parsed.count();
+}
+
+void SaveIndex::intern(Entry *entry)
+{
+    for (QString &value : entry->headerValues) {
+        m_stringPool.intern(&value);
+    }
+    m_stringPool.intern(&entry->levelName);
+}
+
+SaveIndex::Entry SaveIndex::parse(const QString &path, StringPool *stringPool)
+{
+    const QFileInfo info(path);
+
+    Entry entry;
+    entry.path = path;
+    entry.size = info.size();
+    entry.modified = info.lastModified().toMSecsSinceEpoch();
+
+    // Only needs a few fields, so the strings we don't show aren't decoded.
+    // The header values are interned by the load.
+    SaveFile saveFile;
+    saveFile.setLazyDecoding(true);
+    saveFile.setStringPool(stringPool);
+    if (!saveFile.load(path)) {
+        qWarning() << "Failed to load" << path;
+        return entry;
+    }
+    entry.headerChecksum = saveFile.headerChecksum();
+    entry.dataChecksum = saveFile.dataChecksum();
+
+    entry.headerValues.resize(SaveHeader::NumEntries);
+    for (int i=0; i<SaveHeader::NumEntries; i++) {
+        entry.headerValues[i] = saveFile.header().value(SaveHeader::EntryId(i));
+    }
+
+    const SaveData &data = saveFile.data();
+    entry.timestamp = data.m_timestamp;
+    entry.saveFileName = data.saveFileName();
+    entry.gameVersion = data.m_gameVersion;
+    entry.saveVersion = data.m_saveVersion;
+    entry.levelName = data.levelName();
+    entry.isValid = true;
+
+    return entry;
+}
@@ -0,0 +1,57 @@
+#ifndef SAVEINDEX_H
+#define SAVEINDEX_H
+
+#include "SaveFile.h"
+#include "StringPool.h"
+
+#include <QHash>
+#include <QString>
+#include <QDateTime>
+
+// Caches the header and the interesting parts of the data of every save in
+// a directory in a single binary file, so reopening a directory with lots
+// of saves is one sequential read instead of parsing every save again.
+class SaveIndex
+{
+public:
+    struct Entry {
+        // Used to check if the save has changed
+        QString path;
+        qint64 size = 0;
+        qint64 modified = 0; // msecs since epoch
+        quint32 headerChecksum = 0;
+        quint32 dataChecksum = 0;
+
+        bool isValid = false; // kept for broken files too, so we don't reparse them every time
+
+        QVector<QString> headerValues; // indexed by SaveHeader::EntryId
+
+        QDateTime timestamp;
+        QString saveFileName;
+        quint16 gameVersion = 0;
+        quint16 saveVersion = 0;
+        QString levelName;
+    };
+
+    static QString defaultIndexPath(const QString &directory);
+
+    bool load(const QString &indexPath);
+    bool save(const QString &indexPath) const;
+
+    // Scans the directory and only parses the saves that are new or have
+    // changed since the index was built, returns the number parsed.
+    int update(const QString &directory);
+
+    const QHash<QString, Entry> &entries() const { return m_entries; }
+
+private:
+    static Entry parse(const QString &path, StringPool *stringPool);
+
+    // Most saves are in the same few levels with the same header values
+    void intern(Entry *entry);
+
+    QHash<QString, Entry> m_entries;
+    StringPool m_stringPool;
+};
+
+#endif // SAVEINDEX_H
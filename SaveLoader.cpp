@@ -0,0 +1,23 @@
+#include "SaveLoader.h"
+
+SaveLoader::SaveLoader(QObject *parent) : QObject(parent)
+{
+    m_saveFile.setCancellationFlag(&m_cancelled);
+    m_saveFile.setProgressCallback([this](const SaveFile::Stage stage, const qint64 done, const qint64 total) {
+        emit progress(stage, done, total);
+    });
+}
+
+bool SaveLoader::load(const QString &path)
+{
+    return m_saveFile.load(path);
+}
+
+SaveFile SaveLoader::takeSaveFile()
+{
+    // Don't let it call back into us after we're gone
+    SaveFile saveFile = std::move(m_saveFile);
+    saveFile.setProgressCallback({});
+    saveFile.setCancellationFlag(nullptr);
+    return saveFile;
+}
@@ -0,0 +1,40 @@
+#ifndef SAVELOADER_H
+#define SAVELOADER_H
+
+#include "SaveFile.h"
+
+#include <QObject>
+
+#include <atomic>
+
+// Loads a SaveFile with the progress as a signal and support for cancelling,
+// for loading in a worker thread while the UI thread keeps going.
+class SaveLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SaveLoader(QObject *parent = nullptr);
+
+    // Blocks, so call it from a worker thread
+    bool load(const QString &path);
+
+    // Thread safe, makes a running load() return false as soon as possible.
+    // Sticks, so use a new SaveLoader for the next load.
+    void cancel() { m_cancelled = true; }
+    bool isCancelled() const { return m_cancelled; }
+
+    // Only touch these when load() is done
+    const SaveFile &saveFile() const { return m_saveFile; }
+    SaveFile takeSaveFile();
+
+signals:
+    // Emitted from the thread calling load()
+    void progress(SaveFile::Stage stage, qint64 done, qint64 total);
+
+private:
+    SaveFile m_saveFile;
+    std::atomic<bool> m_cancelled{false};
+};
+
+#endif // SAVELOADER_H
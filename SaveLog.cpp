@@ -0,0 +1,6 @@
+#include "SaveLog.h"
+
+// Every string in a save can end up here, so no debug output by default
+Q_LOGGING_CATEGORY(lcSaveFile, "mea.save.file", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcSaveHeader, "mea.save.header", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcSaveData, "mea.save.data", QtInfoMsg)
@@ -0,0 +1,13 @@
+#ifndef SAVELOG_H
+#define SAVELOG_H
+
+#include <QLoggingCategory>
+
+// Debug output of the parser, off unless enabled with QT_LOGGING_RULES
+// (e.g. "mea.save.*.debug=true"). Release and MinSizeRel builds of the
+// parser library define QT_NO_DEBUG_OUTPUT, which compiles it out there.
+Q_DECLARE_LOGGING_CATEGORY(lcSaveFile)   // preamble and checksums
+Q_DECLARE_LOGGING_CATEGORY(lcSaveHeader) // header entries
+Q_DECLARE_LOGGING_CATEGORY(lcSaveData)   // data block fields and strings
+
+#endif // SAVELOG_H
@@ -0,0 +1,273 @@
+#ifndef SAVESCHEMA_H
+#define SAVESCHEMA_H
+
+#include "SaveFile.h"
+
+#include <tuple>
+#include <type_traits>
+
+// The layout of the save structures is described once here, as tuples of
+// field descriptors. The readers and writers for each endianness and save
+// version are generated from that at compile time, so the two can't get out
+// of sync.
+namespace schema {
+
+// How a field is stored
+template<typename T> struct Integer {};     // in the file endianness
+template<int NumBits> struct RawBits {};    // MSB first, not byte swapped
+struct Timestamp32 {};                      // QDateTime as 32 bit seconds since the epoch
+struct String {};
+struct StringList {};
+struct HeaderEntries {};                    // hash + string pairs, as many as the vector holds
+
+using U16 = Integer<quint16>;
+using U32 = Integer<quint32>;
+
+template<typename Kind> struct Codec;
+
+// fixedWidth is whether the encoded size is the same for every value, only
+// those fields can be patched in place
+template<typename T> struct Codec<Integer<T>> {
+    static constexpr bool fixedWidth = true;
+    template<QSysInfo::Endian Endian, typename Io> static void read(Io &io, T &value) {
+        value = io.template read<T, Endian>();
+    }
+    template<QSysInfo::Endian Endian, typename Io> static void write(Io &io, const T &value) {
+        io.template write<T, Endian>(value);
+    }
+};
+
+template<int NumBits> struct Codec<RawBits<NumBits>> {
+    static constexpr bool fixedWidth = true;
+    template<QSysInfo::Endian, typename Io, typename T> static void read(Io &io, T &value) {
+        value = io.m_input->template read<T>(NumBits);
+    }
+    template<QSysInfo::Endian, typename Io, typename T> static void write(Io &io, const T &value) {
+        io.m_output->template write<T>(NumBits, value);
+    }
+};
+
+template<> struct Codec<Timestamp32> {
+    static constexpr bool fixedWidth = true;
+    template<QSysInfo::Endian Endian, typename Io> static void read(Io &io, QDateTime &value) {
+        value = QDateTime::fromSecsSinceEpoch(io.template read<quint32, Endian>());
+    }
+    template<QSysInfo::Endian Endian, typename Io> static void write(Io &io, const QDateTime &value) {
+        io.template write<quint32, Endian>(value.toSecsSinceEpoch());
+    }
+};
+
+template<> struct Codec<String> {
+    static constexpr bool fixedWidth = false;
+    template<QSysInfo::Endian Endian, typename Io> static void read(Io &io, QString &value) {
+        value = io.template readString<Endian>();
+    }
+    template<QSysInfo::Endian Endian, typename Io> static void write(Io &io, const QString &value) {
+        io.template writeString<Endian>(value);
+    }
+    template<QSysInfo::Endian Endian, typename Io> static void skip(Io &io) {
+        io.template skipString<Endian>();
+    }
+};
+
+template<> struct Codec<StringList> {
+    static constexpr bool fixedWidth = false;
+    template<QSysInfo::Endian Endian, typename Io> static void read(Io &io, QStringList &value) {
+        value = io.template readStringList<Endian>();
+    }
+    template<QSysInfo::Endian Endian, typename Io> static void write(Io &io, const QStringList &value) {
+        io.template writeStringList<Endian>(value);
+    }
+    template<QSysInfo::Endian Endian, typename Io> static void skip(Io &io) {
+        io.template skipStringList<Endian>();
+    }
+};
+
+template<> struct Codec<HeaderEntries> {
+    static constexpr bool fixedWidth = false;
+    template<QSysInfo::Endian Endian, typename Io> static void read(Io &io, QVector<SaveHeader::Value> &values) {
+        for (SaveHeader::Value &entry : values) {
+            entry.hash = io.template read<quint32, Endian>();
+            entry.value = io.template readString<Endian>();
+            if (!io.m_ok) {
+                return;
+            }
+        }
+    }
+    template<QSysInfo::Endian Endian, typename Io> static void write(Io &io, const QVector<SaveHeader::Value> &values) {
+        for (const SaveHeader::Value &entry : values) {
+            io.template write<quint32, Endian>(entry.hash);
+            io.template writeString<Endian>(entry.value);
+        }
+    }
+};
+
+// Condition is an optional member that needs to be non-zero for the field to be present
+template<typename Kind, typename Class, typename Member, quint16 MinVersion, quint16 MaxVersion, typename Condition>
+struct Field {
+    using Codec = schema::Codec<Kind>;
+
+    static constexpr bool presentIn(const quint16 version) {
+        return version >= MinVersion && version <= MaxVersion;
+    }
+
+    template<typename Object>
+    constexpr bool isPresent(const Object &object) const {
+        if constexpr (std::is_same<Condition, std::nullptr_t>::value) {
+            return true;
+        } else {
+            return object.*condition;
+        }
+    }
+
+    const char *name;
+    Member Class::*member;
+    Condition condition;
+};
+
+template<typename Kind, quint16 MinVersion = 0, quint16 MaxVersion = 0xffff, typename Class, typename Member>
+constexpr auto field(const char *name, Member Class::*member)
+{
+    return Field<Kind, Class, Member, MinVersion, MaxVersion, std::nullptr_t>{name, member, nullptr};
+}
+
+template<typename Kind, typename Class, typename Member, typename ConditionMember>
+constexpr auto optionalField(const char *name, Member Class::*member, ConditionMember Class::*condition)
+{
+    return Field<Kind, Class, Member, 0, 0xffff, ConditionMember Class::*>{name, member, condition};
+}
+
+// Version 0 is used for the structures that don't change between versions
+template<QSysInfo::Endian Endian, quint16 Version, typename Object, typename FieldType>
+inline bool readField(Object &object, const FieldType &field)
+{
+    if constexpr (FieldType::presentIn(Version)) {
+        if (field.isPresent(object)) {
+            object.recordField(field.name);
+            FieldType::Codec::template read<Endian>(object, object.*field.member);
+        }
+    }
+    return object.m_ok;
+}
+
+template<QSysInfo::Endian Endian, quint16 Version, typename Object, typename FieldType>
+inline bool writeField(Object &object, const FieldType &field)
+{
+    if constexpr (FieldType::presentIn(Version)) {
+        if (field.isPresent(object)) {
+            FieldType::Codec::template write<Endian>(object, object.*field.member);
+        }
+    }
+    return object.m_ok;
+}
+
+// Reads the fixed width fields as usual, but only steps over the rest and
+// remembers where they are so they can be decoded later
+template<QSysInfo::Endian Endian, quint16 Version, typename Object, typename FieldType>
+inline bool indexField(Object &object, const FieldType &field)
+{
+    if constexpr (FieldType::presentIn(Version)) {
+        if (field.isPresent(object)) {
+            object.recordField(field.name);
+            if constexpr (FieldType::Codec::fixedWidth) {
+                FieldType::Codec::template read<Endian>(object, object.*field.member);
+            } else {
+                object.recordLazyField(field.name);
+                object.*field.member = {}; // not whatever was there before
+                FieldType::Codec::template skip<Endian>(object);
+            }
+        }
+    }
+    return object.m_ok;
+}
+
+template<QSysInfo::Endian Endian, quint16 Version = 0, typename Object, typename... Fields>
+inline bool read(Object &object, const std::tuple<Fields...> &fields)
+{
+    return std::apply([&object](const Fields &...field) {
+        return (readField<Endian, Version>(object, field) && ...);
+    }, fields);
+}
+
+template<QSysInfo::Endian Endian, quint16 Version = 0, typename Object, typename... Fields>
+inline bool write(Object &object, const std::tuple<Fields...> &fields)
+{
+    return std::apply([&object](const Fields &...field) {
+        return (writeField<Endian, Version>(object, field) && ...);
+    }, fields);
+}
+
+template<QSysInfo::Endian Endian, quint16 Version = 0, typename Object, typename... Fields>
+inline bool index(Object &object, const std::tuple<Fields...> &fields)
+{
+    return std::apply([&object](const Fields &...field) {
+        return (indexField<Endian, Version>(object, field) && ...);
+    }, fields);
+}
+
+// Calls function with the descriptor of the field called name, returns false if there's none
+template<typename Function, typename... Fields>
+inline bool forField(const std::tuple<Fields...> &fields, const char *name, Function &&function)
+{
+    return std::apply([&](const Fields &...field) {
+        return ((qstrcmp(field.name, name) == 0 && (function(field), true)) || ...);
+    }, fields);
+}
+
+// Calls function with a std::integral_constant for the save version, so the
+// reader and writer for that version are picked at compile time
+template<typename Function>
+inline bool forSaveVersion(const quint16 version, Function &&function)
+{
+    switch (version) {
+    case 20:
+        function(std::integral_constant<quint16, 20>());
+        return true;
+    case 21:
+        function(std::integral_constant<quint16, 21>());
+        return true;
+    case 22:
+        function(std::integral_constant<quint16, 22>());
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Follows the FBHEADER magic
+inline constexpr auto headerPreamble = std::make_tuple(
+    field<U16>("version", &SaveHeader::m_version),
+    field<U32>("entryCount", &SaveHeader::m_entryCount)
+);
+
+inline constexpr auto headerEntries = std::make_tuple(
+    field<HeaderEntries>("entries", &SaveHeader::m_values)
+);
+
+// Follows the FB\0SAVE\n magic
+inline constexpr auto baseSave = std::make_tuple(
+    field<RawBits<4>>("unknownFlags", &BaseSave::m_unknownFlags),
+    optionalField<RawBits<27>>("unknownBits", &BaseSave::m_unknownBits, &BaseSave::m_unknownFlags)
+);
+
+// Everything up to and including the save version, the same in all versions
+inline constexpr auto saveDataPrefix = std::make_tuple(
+    field<Timestamp32>("timestamp", &SaveData::m_timestamp), // TODO: gibbed's code reads 64 bits here, but there's just 32 until the string starts
+    field<String>("saveFileName", &SaveData::m_saveFileName),
+    field<U16>("gameVersion", &SaveData::m_gameVersion),
+    field<U16>("saveVersion", &SaveData::m_saveVersion)
+);
+
+// Use the MinVersion/MaxVersion arguments of field() for things that differ between versions
+inline constexpr auto saveDataBody = std::make_tuple(
+    field<U16, 20, 22>("unknown1", &SaveData::m_unknown1),
+    field<U16, 20, 22>("unknown2", &SaveData::m_unknown2),
+    field<U32, 20, 22>("userBuildInfo", &SaveData::m_userBuildInfo),
+    field<String, 20, 22>("levelName", &SaveData::m_levelName),
+    field<U32, 20, 22>("unknown3", &SaveData::m_unknown3), // probably related to the level name
+    field<StringList, 20, 22>("preloadedBundles", &SaveData::m_preloadedBundles)
+);
+
+} // namespace schema
+
+#endif // SAVESCHEMA_H
@@ -0,0 +1,107 @@
+#include "SaveTrace.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+
+SaveTrace::SaveTrace()
+{
+    m_timer.start();
+}
+
+SaveTrace::Span::Span(SaveTrace *trace, const char *name, const QString &detail) :
+    m_trace(trace),
+    m_name(name)
+{
+    if (!m_trace) {
+        return;
+    }
+    m_detail = detail;
+    m_start = m_trace->m_timer.nsecsElapsed();
+}
+
+SaveTrace::Span::~Span()
+{
+    if (!m_trace) {
+        return;
+    }
+    Event event;
+    event.name = m_name;
+    event.detail = m_detail;
+    event.start = m_start;
+    event.duration = m_trace->m_timer.nsecsElapsed() - m_start;
+    m_trace->add(event);
+}
+
+void SaveTrace::add(Event event)
+{
+    const quintptr threadId = quintptr(QThread::currentThreadId());
+
+    QMutexLocker locker(&m_mutex);
+    auto thread = m_threads.constFind(threadId);
+    if (thread == m_threads.constEnd()) {
+        thread = m_threads.insert(threadId, m_threads.count() + 1);
+    }
+    event.thread = *thread;
+    m_events.append(event);
+}
+
+int SaveTrace::count() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_events.count();
+}
+
+void SaveTrace::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_events.clear();
+    m_threads.clear();
+}
+
+QByteArray SaveTrace::toChromeTrace() const
+{
+    QJsonArray events;
+
+    QMutexLocker locker(&m_mutex);
+    for (const Event &event : m_events) {
+        QJsonObject json;
+        json["name"] = QString::fromLatin1(event.name);
+        json["cat"] = QStringLiteral("load");
+        json["ph"] = QStringLiteral("X");
+        json["ts"] = event.start / 1000.;
+        json["dur"] = event.duration / 1000.;
+        json["pid"] = 1;
+        json["tid"] = event.thread;
+        if (!event.detail.isEmpty()) {
+            QJsonObject args;
+            args["detail"] = event.detail;
+            json["args"] = args;
+        }
+        events.append(json);
+    }
+    locker.unlock();
+
+    QJsonObject trace;
+    trace["traceEvents"] = events;
+    trace["displayTimeUnit"] = QStringLiteral("ns");
+    return QJsonDocument(trace).toJson(QJsonDocument::Compact);
+}
+
+bool SaveTrace::save(const QString &path) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open" << path << file.errorString();
+        return false;
+    }
+    const QByteArray json = toChromeTrace();
+    if (file.write(json) != json.size()) {
+        qWarning() << "Failed to write trace" << file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef SAVETRACE_H
+#define SAVETRACE_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+// Collects how long each stage of loading took, for profiling real loads.
+// The result can be opened in chrome://tracing or Perfetto. Thread safe, so
+// one trace can be shared by the saves loaded in parallel.
+class SaveTrace
+{
+public:
+    SaveTrace();
+
+    // Times its own lifetime. Does nothing if the trace is null, so the
+    // load functions can always create them.
+    class Span
+    {
+    public:
+        Span(SaveTrace *trace, const char *name, const QString &detail = QString());
+        ~Span();
+
+        Span(const Span&) = delete;
+        Span &operator=(const Span&) = delete;
+
+    private:
+        SaveTrace *m_trace;
+        const char *m_name;
+        QString m_detail;
+        qint64 m_start = 0;
+    };
+
+    int count() const;
+    void clear();
+
+    // Chrome trace event format, complete ("X") events in microseconds
+    QByteArray toChromeTrace() const;
+    bool save(const QString &path) const;
+
+private:
+    struct Event {
+        const char *name = nullptr; // span names are string literals
+        QString detail;
+        qint64 start = 0; // nanoseconds since the trace was created
+        qint64 duration = 0;
+        int thread = 0;
+    };
+
+    void add(Event event);
+
+    QElapsedTimer m_timer;
+
+    mutable QMutex m_mutex;
+    QVector<Event> m_events;
+    QHash<quintptr, int> m_threads; // numbered in order of appearance, the real ids are too big for JSON
+};
+
+#endif // SAVETRACE_H
@@ -0,0 +1,187 @@
+#include "SaveWatcher.h"
+
+#include "SaveFile.h"
+
+#include <QBuffer>
+#include <QDir>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+SaveWatcher::SaveWatcher(const QString &directory, QObject *parent) : QObject(parent),
+    m_directory(QDir(directory).absolutePath())
+{
+    m_settleTimer.setSingleShot(true);
+    m_settleTimer.setInterval(s_settleTime);
+    connect(&m_settleTimer, &QTimer::timeout, this, &SaveWatcher::processPending);
+
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &SaveWatcher::onDirectoryChanged);
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &SaveWatcher::onFileChanged);
+
+    if (!m_watcher.addPath(m_directory)) {
+        qWarning() << "Failed to watch" << m_directory;
+        return;
+    }
+
+    // Only interested in what happens from now on
+    const QStringList existing = QDir(m_directory).entryList(QDir::Files);
+    for (const QString &name : existing) {
+        const QString path = QDir(m_directory).filePath(name);
+        m_known.insert(path);
+        m_watcher.addPath(path);
+    }
+}
+
+void SaveWatcher::onDirectoryChanged()
+{
+    // Only tells us that something changed, but listing the names is cheap
+    // and we only care about the new ones, changes to existing files come
+    // through fileChanged(). Files that were replaced have lost their watch,
+    // so treat them as new.
+    const QStringList names = QDir(m_directory).entryList(QDir::Files);
+    QSet<QString> watched;
+    const QStringList watchedFiles = m_watcher.files();
+    watched.reserve(watchedFiles.count());
+    for (const QString &path : watchedFiles) {
+        watched.insert(path);
+    }
+    QSet<QString> current;
+    for (const QString &name : names) {
+        const QString path = QDir(m_directory).filePath(name);
+        current.insert(path);
+        if (!m_known.contains(path) || !watched.contains(path)) {
+            m_watcher.addPath(path);
+            schedule(path);
+        }
+    }
+    m_known = current;
+}
+
+void SaveWatcher::onFileChanged(const QString &path)
+{
+    // Saves are often written to a temporary file and renamed, which drops the watch
+    if (QFileInfo::exists(path) && !m_watcher.files().contains(path)) {
+        m_watcher.addPath(path);
+    }
+    schedule(path);
+}
+
+void SaveWatcher::schedule(const QString &path)
+{
+    m_pending.insert(path);
+    m_settleTimer.start();
+}
+
+void SaveWatcher::processPending()
+{
+    const QSet<QString> pending = m_pending;
+    m_pending.clear();
+
+    for (const QString &path : pending) {
+        if (m_loading.contains(path)) {
+            // Picked up again when the current one finishes
+            m_pending.insert(path);
+            continue;
+        }
+        if (!QFileInfo::exists(path)) {
+            continue;
+        }
+        m_loading.insert(path);
+
+        QFutureWatcher<Result> *futureWatcher = new QFutureWatcher<Result>(this);
+        connect(futureWatcher, &QFutureWatcher<Result>::finished, this, [this, futureWatcher]() {
+            onLoaded(futureWatcher->result());
+            futureWatcher->deleteLater();
+        });
+        futureWatcher->setFuture(QtConcurrent::run(&SaveWatcher::load, path));
+    }
+}
+
+void SaveWatcher::onLoaded(const Result &result)
+{
+    m_loading.remove(result.path);
+
+    if (!result.complete) {
+        // Still being written, try again unless it's just broken
+        const int retries = ++m_retries[result.path];
+        if (retries < s_maxRetries) {
+            schedule(result.path);
+        } else if (result.isSave) {
+            qWarning() << "Giving up on" << result.path;
+            m_retries.remove(result.path);
+            emit saveFailed(result.path);
+        } else {
+            // Never got past the first few bytes
+            m_retries.remove(result.path);
+        }
+        return;
+    }
+    m_retries.remove(result.path);
+
+    if (!result.isSave) {
+        // Something else in the save directory
+    } else if (!result.saveFile) {
+        emit saveFailed(result.path);
+    } else {
+        emit saveLoaded(result.path, result.saveFile);
+    }
+
+    if (!m_pending.isEmpty() && !m_settleTimer.isActive()) {
+        m_settleTimer.start();
+    }
+}
+
+bool SaveWatcher::isComplete(const QByteArray &contents)
+{
+    QBuffer buffer;
+    buffer.setData(contents);
+    if (!buffer.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // The lengths in the preamble need to add up to the file size, and the
+    // header checksum needs to match, the data checksum is checked on load.
+    const SaveMetadata metadata = SaveFile::scanHeader(&buffer);
+    if (!metadata.isValid) {
+        return false;
+    }
+    static constexpr qint64 preambleSize = sizeof(quint64) + sizeof(quint16) + 2 * sizeof(quint32);
+    return contents.size() == preambleSize + metadata.headerLength + metadata.dataLength;
+}
+
+SaveWatcher::Result SaveWatcher::load(const QString &path)
+{
+    Result result;
+    result.path = path;
+
+    // Read instead of mapped, the game might truncate the file while we're
+    // parsing it, which would crash instead of failing the load
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return result;
+    }
+    const QByteArray contents = file.readAll();
+    if (contents.size() < qint64(sizeof(quint64))) {
+        // Too short to tell yet
+        return result;
+    }
+    if (!SaveFile::hasMagic(contents.constData(), contents.size())) {
+        // Not a save, so waiting for it to be written won't help
+        result.complete = true;
+        return result;
+    }
+    result.isSave = true;
+    if (!isComplete(contents)) {
+        return result;
+    }
+
+    QSharedPointer<SaveFile> saveFile(new SaveFile);
+    if (!saveFile->load(contents.constData(), contents.size())) {
+        // The lengths add up, so most likely the data is still being written
+        return result;
+    }
+
+    result.complete = true;
+    result.saveFile = saveFile;
+    return result;
+}
@@ -0,0 +1,61 @@
+#ifndef SAVEWATCHER_H
+#define SAVEWATCHER_H
+
+#include <QObject>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QSet>
+#include <QHash>
+#include <QSharedPointer>
+
+class SaveFile;
+
+// Watches a save directory and parses saves as the game writes them, one
+// file at a time and off the UI thread.
+class SaveWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SaveWatcher(const QString &directory, QObject *parent = nullptr);
+
+    QString directory() const { return m_directory; }
+
+signals:
+    void saveLoaded(const QString &path, QSharedPointer<SaveFile> saveFile);
+    void saveFailed(const QString &path);
+
+private slots:
+    void onDirectoryChanged();
+    void onFileChanged(const QString &path);
+    void processPending();
+
+private:
+    struct Result {
+        QString path;
+        QSharedPointer<SaveFile> saveFile;
+        bool complete = false;
+        bool isSave = false; // starts with the magic, not some other file in the directory
+    };
+
+    static bool isComplete(const QByteArray &contents);
+    static Result load(const QString &path);
+
+    void schedule(const QString &path);
+    void onLoaded(const Result &result);
+
+    // The game writes in several steps, so wait a bit for things to settle
+    static constexpr int s_settleTime = 20; // ms
+    static constexpr int s_maxRetries = 50;
+
+    QString m_directory;
+    QFileSystemWatcher m_watcher;
+    QTimer m_settleTimer;
+
+    QSet<QString> m_known;
+    QSet<QString> m_pending;
+    QSet<QString> m_loading;
+    QHash<QString, int> m_retries;
+};
+
+#endif // SAVEWATCHER_H
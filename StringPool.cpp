@@ -0,0 +1,52 @@
+#include "StringPool.h"
+
+QString StringPool::intern(const QString &string)
+{
+    if (string.isEmpty()) {
+        return QString();
+    }
+
+    Shard &shard = m_shards[qHash(string) % NumShards];
+
+    // Almost everything is already there after the first few saves
+    {
+        QReadLocker locker(&shard.lock);
+        auto it = shard.strings.constFind(string);
+        if (it != shard.strings.constEnd()) {
+            return *it;
+        }
+    }
+
+    QWriteLocker locker(&shard.lock);
+    auto it = shard.strings.constFind(string);
+    if (it != shard.strings.constEnd()) {
+        return *it;
+    }
+    shard.strings.insert(string);
+    return string;
+}
+
+void StringPool::intern(QStringList *strings)
+{
+    for (QString &string : *strings) {
+        string = intern(string);
+    }
+}
+
+int StringPool::count() const
+{
+    int count = 0;
+    for (const Shard &shard : m_shards) {
+        QReadLocker locker(&shard.lock);
+        count += shard.strings.count();
+    }
+    return count;
+}
+
+void StringPool::clear()
+{
+    for (Shard &shard : m_shards) {
+        QWriteLocker locker(&shard.lock);
+        shard.strings.clear();
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <QReadWriteLock>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+#include <array>
+
+// Keeps one copy of each distinct string for a batch of saves, like the
+// bundle names and header values that are the same in every file. Equal
+// interned strings share their data, so constData() can be compared instead
+// of the contents. Thread safe, so the saves can be loaded in parallel.
+// Strings stay in the pool until clear(), even when no save uses them.
+class StringPool
+{
+public:
+    QString intern(const QString &string);
+
+    void intern(QString *string) { *string = intern(*string); }
+    void intern(QStringList *strings);
+
+    int count() const;
+    void clear();
+
+private:
+    // Split by hash so threads interning different strings don't wait for each other
+    static constexpr int NumShards = 16;
+
+    struct Shard {
+        mutable QReadWriteLock lock;
+        QSet<QString> strings;
+    };
+    std::array<Shard, NumShards> m_shards;
+};
+
+#endif // STRINGPOOL_H
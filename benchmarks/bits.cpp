@@ -0,0 +1,86 @@
+#include "harness.h"
+
+#include "bits/bits-stream.h"
+#include "bits/bits-reader.h"
+
+#include <memory>
+#include <random>
+
+namespace benchmark {
+
+static constexpr size_t s_bufferSize = 4 * 1024 * 1024;
+
+// Every iteration reads this many consecutive fields
+static constexpr size_t s_fields = 4096;
+
+template<typename T>
+static void registerWidth(Suite &suite, const std::shared_ptr<std::vector<unsigned char>> &buffer, const int width)
+{
+    const std::string suffix = "/" + std::to_string(width);
+    const uint64_t bytes = s_fields * width / 8;
+
+    // Walk through the buffer so it isn't all from L1, leaving room at the
+    // end as getbitbuffer reads up to 2 * sizeof(T) bytes past a field
+    const size_t span = s_fields * width;
+    const size_t wrap = (s_bufferSize - 16) * 8 - span;
+
+    suite.add("getbitbuffer" + suffix, bytes, [buffer, width, span, wrap, offset = size_t(3)]() mutable {
+        T sum = 0;
+        for (size_t field=0; field<s_fields; field++) {
+            sum += bits::getbitbuffer<T>(buffer->data(), offset + field * width, width);
+        }
+        doNotOptimize(sum);
+        offset = (offset + span) % wrap;
+    });
+
+    suite.add("bitreader::read" + suffix, bytes, [buffer, width, span, wrap, offset = size_t(3)]() mutable {
+        bits::bitreader reader(buffer->data(), s_bufferSize);
+        reader.seek(offset);
+        T sum = 0;
+        for (size_t field=0; field<s_fields; field++) {
+            sum += reader.read<T>(width);
+        }
+        doNotOptimize(sum);
+        offset = (offset + span) % wrap;
+    });
+}
+
+void registerBits(Suite &suite)
+{
+    std::shared_ptr<std::vector<unsigned char>> buffer = std::make_shared<std::vector<unsigned char>>(s_bufferSize);
+    std::mt19937 random(1337);
+    for (unsigned char &c : *buffer) {
+        c = random();
+    }
+
+    // bitstream is only correct for sub-width reads of types at least as big as an int
+    for (const int width : { 1, 4, 8, 13, 16, 27, 32 }) {
+        registerWidth<unsigned>(suite, buffer, width);
+    }
+    for (const int width : { 33, 64 }) {
+        registerWidth<uint64_t>(suite, buffer, width);
+    }
+
+    // Strings in the saves are a few bytes to a few hundred, and rarely byte aligned
+    for (const int length : { 16, 256, 4096 }) {
+        for (const int offset : { 0, 5 }) {
+            const std::string suffix = "/" + std::to_string(length) + (offset ? "/unaligned" : "/aligned");
+            std::shared_ptr<std::vector<unsigned char>> output = std::make_shared<std::vector<unsigned char>>(length);
+
+            suite.add("bitstream::peekstring" + suffix, length, [buffer, output, length, offset]() {
+                bits::bitstream stream(buffer->data());
+                stream.seek(offset);
+                stream.peekstring(output->data(), length * 8);
+                doNotOptimize(output->front());
+            });
+            suite.add("bitreader::peekstring" + suffix, length, [buffer, output, length, offset]() {
+                bits::bitreader reader(buffer->data(), s_bufferSize);
+                reader.seek(offset);
+                reader.peekstring(output->data(), length * 8);
+                doNotOptimize(output->front());
+            });
+        }
+    }
+}
+
+} // namespace benchmark
@@ -0,0 +1,44 @@
+#include "harness.h"
+
+#include "Crc32.h"
+
+#include <memory>
+#include <random>
+
+namespace benchmark {
+
+void registerCrc32(Suite &suite)
+{
+    // From a header to a big data block, at an odd offset like inside a save
+    static const std::vector<size_t> sizes = { 64, 4 * 1024, 256 * 1024, 1024 * 1024, 64 * 1024 * 1024 };
+
+    std::shared_ptr<std::vector<uchar>> buffer = std::make_shared<std::vector<uchar>>(sizes.back() + 1);
+    std::mt19937 random(1337);
+    for (uchar &c : *buffer) {
+        c = random();
+    }
+    const uchar *data = buffer->data() + 1;
+
+    for (const size_t size : sizes) {
+        const std::string suffix = "/" + std::to_string(size);
+
+        suite.add("calculateCrc32" + suffix, size, [buffer, data, size]() {
+            doNotOptimize(calculateCrc32(reinterpret_cast<const char*>(data), size, 0x12345678));
+        });
+        suite.add("crc32::calculateSliceBy16" + suffix, size, [buffer, data, size]() {
+            doNotOptimize(crc32::calculateSliceBy16(data, size, 0x12345678));
+        });
+        if (crc32::hasPclmul()) {
+            suite.add("crc32::calculatePclmul" + suffix, size, [buffer, data, size]() {
+                doNotOptimize(crc32::calculatePclmul(data, size, 0x12345678));
+            });
+        }
+        if (size >= 1024 * 1024) {
+            suite.add("crc32::calculateParallel" + suffix, size, [buffer, data, size]() {
+                doNotOptimize(crc32::calculateParallel(data, size, 0x12345678));
+            });
+        }
+    }
+}
+
+} // namespace benchmark
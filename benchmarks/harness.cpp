@@ -0,0 +1,158 @@
+#include "harness.h"
+
+#include "AllocationStats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <thread>
+
+namespace benchmark {
+
+// The --save ones have file names in them
+static std::string escapeJson(const std::string &string)
+{
+    std::string ret;
+    ret.reserve(string.size());
+    for (const char c : string) {
+        switch (c) {
+        case '"': ret += "\\\""; break;
+        case '\\': ret += "\\\\"; break;
+        case '\n': ret += "\\n"; break;
+        case '\r': ret += "\\r"; break;
+        case '\t': ret += "\\t"; break;
+        default:
+            if (uint8_t(c) < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                ret += escaped;
+            } else {
+                ret += c;
+            }
+        }
+    }
+    return ret;
+}
+
+void Suite::add(const std::string &name, const uint64_t bytes, std::function<void()> function)
+{
+    m_cases.push_back({name, bytes, std::move(function)});
+}
+
+Result Suite::run(const Case &benchmarkCase) const
+{
+    using Clock = std::chrono::steady_clock;
+
+    Result result;
+    result.name = benchmarkCase.name;
+    result.bytes = benchmarkCase.bytes;
+
+    // Warm up, and find how many iterations fill a batch
+    uint64_t batchSize = 1;
+    for (;;) {
+        const Clock::time_point start = Clock::now();
+        for (uint64_t i=0; i<batchSize; i++) {
+            benchmarkCase.function();
+        }
+        const double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (elapsed >= m_minBatchTime || batchSize >= (uint64_t(1) << 40)) {
+            break;
+        }
+        // Aim a bit over, so we don't end up just short every time
+        const double scale = elapsed > 0 ? 1.4 * m_minBatchTime / elapsed : 10;
+        batchSize = std::max(batchSize + 1, uint64_t(batchSize * std::min(scale, 10.)));
+    }
+
+    std::vector<double> times;
+    for (int batch=0; batch<m_batches; batch++) {
+        const Clock::time_point start = Clock::now();
+        for (uint64_t i=0; i<batchSize; i++) {
+            benchmarkCase.function();
+        }
+        const double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        times.push_back(elapsed / batchSize);
+        result.iterations += batchSize;
+    }
+    std::sort(times.begin(), times.end());
+    result.bestNs = times.front();
+    result.medianNs = times[times.size() / 2];
+
+    // Separately, so the counting doesn't affect the timing
+    if (m_countAllocations && AllocationStats::isEnabled()) {
+        AllocationStats::Counters counters;
+        {
+            AllocationStats::Scope scope(&counters);
+            benchmarkCase.function();
+        }
+        result.countedAllocations = true;
+        result.allocations = counters.allocations;
+        result.allocatedBytes = counters.bytes;
+        result.peakBytes = counters.peak;
+    }
+
+    return result;
+}
+
+std::vector<Result> Suite::run() const
+{
+    std::vector<Result> results;
+
+    fprintf(stderr, "%-44s %14s %14s %12s\n", "benchmark", "best ns", "median ns", "MB/s");
+    for (const Case &benchmarkCase : m_cases) {
+        if (benchmarkCase.name.find(m_filter) == std::string::npos) {
+            continue;
+        }
+        const Result result = run(benchmarkCase);
+        if (result.bytes) {
+            fprintf(stderr, "%-44s %14.1f %14.1f %12.1f\n", result.name.c_str(), result.bestNs, result.medianNs,
+                    result.bytes / result.bestNs * 1e3);
+        } else {
+            fprintf(stderr, "%-44s %14.1f %14.1f %12s\n", result.name.c_str(), result.bestNs, result.medianNs, "-");
+        }
+        if (result.countedAllocations) {
+            fprintf(stderr, "%-44s %14llu allocations, %llu bytes, %llu peak\n", "",
+                    (unsigned long long) result.allocations, (unsigned long long) result.allocatedBytes,
+                    (unsigned long long) result.peakBytes);
+        }
+        results.push_back(result);
+    }
+
+    return results;
+}
+
+void Suite::writeJson(FILE *output, const std::vector<Result> &results)
+{
+    char date[64] = {};
+    const std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+
+    fprintf(output, "{\n  \"context\": {\n");
+    fprintf(output, "    \"date\": \"%s\",\n", date);
+    fprintf(output, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+#if defined(__VERSION__)
+    fprintf(output, "    \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+#if defined(NDEBUG)
+    fprintf(output, "    \"library_build_type\": \"release\"\n");
+#else
+    fprintf(output, "    \"library_build_type\": \"debug\"\n");
+#endif
+    fprintf(output, "  },\n  \"benchmarks\": [\n");
+    for (size_t i=0; i<results.size(); i++) {
+        const Result &result = results[i];
+        fprintf(output, "    {\"name\": \"%s\", \"iterations\": %llu, \"real_time\": %.3f, \"median_time\": %.3f, \"time_unit\": \"ns\"",
+                escapeJson(result.name).c_str(), (unsigned long long) result.iterations, result.bestNs, result.medianNs);
+        if (result.bytes) {
+            fprintf(output, ", \"bytes_per_second\": %.1f", result.bytes / result.bestNs * 1e9);
+        }
+        if (result.countedAllocations) {
+            fprintf(output, ", \"allocations\": %llu, \"allocated_bytes\": %llu, \"peak_bytes\": %llu",
+                    (unsigned long long) result.allocations, (unsigned long long) result.allocatedBytes,
+                    (unsigned long long) result.peakBytes);
+        }
+        fprintf(output, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(output, "  ]\n}\n");
+}
+
+} // namespace benchmark
@@ -0,0 +1,82 @@
+#ifndef BENCHMARK_HARNESS_H
+#define BENCHMARK_HARNESS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Minimal benchmark harness. Each case runs in batches long enough to be timed
+// reliably, the fastest batch is what gets reported (with the median for an
+// idea of the noise).
+namespace benchmark {
+
+// Keeps the compiler from optimizing away a result nobody looks at
+template<typename T>
+inline void doNotOptimize(const T &value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const T *sink;
+    sink = &value;
+#endif
+}
+
+struct Case {
+    std::string name;
+    uint64_t bytes; // processed per iteration, 0 if throughput doesn't make sense
+    std::function<void()> function;
+};
+
+struct Result {
+    std::string name;
+    uint64_t bytes = 0;
+    uint64_t iterations = 0; // in all batches
+    double bestNs = 0;       // per iteration
+    double medianNs = 0;     // per iteration
+
+    // Of one more iteration after the timed ones, only with setCountAllocations()
+    bool countedAllocations = false;
+    uint64_t allocations = 0;
+    uint64_t allocatedBytes = 0;
+    uint64_t peakBytes = 0;
+};
+
+class Suite
+{
+public:
+    void add(const std::string &name, const uint64_t bytes, std::function<void()> function);
+
+    // Only runs the cases with a name containing filter
+    void setFilter(const std::string &filter) { m_filter = filter; }
+    void setMinBatchTime(const double milliseconds) { m_minBatchTime = milliseconds; }
+    void setBatches(const int batches) { m_batches = batches; }
+    // Needs AllocationStats to be available
+    void setCountAllocations(const bool count) { m_countAllocations = count; }
+
+    // Prints a table to stderr as it goes
+    std::vector<Result> run() const;
+
+    // Uses the same keys as Google Benchmark, so the same tools can compare runs
+    static void writeJson(FILE *output, const std::vector<Result> &results);
+
+private:
+    Result run(const Case &benchmarkCase) const;
+
+    std::vector<Case> m_cases;
+    std::string m_filter;
+    double m_minBatchTime = 50;
+    int m_batches = 5;
+    bool m_countAllocations = false;
+};
+
+// Implemented next to the code they measure
+void registerCrc32(Suite &suite);
+void registerBits(Suite &suite);
+void registerLoad(Suite &suite, const std::vector<std::string> &saveFiles);
+
+} // namespace benchmark
+
+#endif // BENCHMARK_HARNESS_H
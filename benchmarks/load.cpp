@@ -0,0 +1,72 @@
+#include "harness.h"
+
+#include "SaveDataView.h"
+#include "SaveFile.h"
+#include "SaveGenerator.h"
+
+#include <QFile>
+#include <QFileInfo>
+
+#include <memory>
+
+namespace benchmark {
+
+static void addLoad(Suite &suite, const std::string &name, const std::shared_ptr<QByteArray> &save)
+{
+    suite.add("SaveFile::load/" + name, save->size(), [save]() {
+        SaveFile saveFile;
+        doNotOptimize(saveFile.load(save->constData(), save->size()));
+    });
+
+    // Like the save browser, which only shows the level name
+    suite.add("SaveFile::load/lazy/" + name, save->size(), [save]() {
+        SaveFile saveFile;
+        saveFile.setLazyDecoding(true);
+        doNotOptimize(saveFile.load(save->constData(), save->size()));
+        doNotOptimize(saveFile.data().levelName());
+    });
+
+    // Reuses the arena between iterations, like a batch job would
+    std::shared_ptr<SaveDataView> view = std::make_shared<SaveDataView>();
+    suite.add("SaveDataView::load/" + name, save->size(), [save, view]() {
+        doNotOptimize(view->load(save->constData(), save->size()));
+    });
+}
+
+void registerLoad(Suite &suite, const std::vector<std::string> &saveFiles)
+{
+    // Real autosaves are a couple of megabytes
+    static const std::vector<std::pair<std::string, qint64>> sizes = {
+        { "64k", 64 * 1024 },
+        { "2m", 2 * 1024 * 1024 },
+        { "32m", 32 * 1024 * 1024 },
+    };
+    for (const std::pair<std::string, qint64> &size : sizes) {
+        SaveGenerator::Options options;
+        options.remainderSize = size.second;
+
+        options.endian = QSysInfo::LittleEndian;
+        addLoad(suite, "little/" + size.first, std::make_shared<QByteArray>(SaveGenerator::generate(options, 1337)));
+        options.endian = QSysInfo::BigEndian;
+        addLoad(suite, "big/" + size.first, std::make_shared<QByteArray>(SaveGenerator::generate(options, 1337)));
+    }
+
+    for (const std::string &path : saveFiles) {
+        const QString filePath = QString::fromStdString(path);
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            fprintf(stderr, "Failed to open %s\n", path.c_str());
+            continue;
+        }
+        const std::string name = QFileInfo(filePath).fileName().toStdString();
+        addLoad(suite, "file/" + name, std::make_shared<QByteArray>(file.readAll()));
+
+        // Including opening and mapping the file
+        suite.add("SaveFile::load/file/" + name + "/path", file.size(), [filePath]() {
+            SaveFile saveFile;
+            doNotOptimize(saveFile.load(filePath));
+        });
+    }
+}
+
+} // namespace benchmark
@@ -0,0 +1,76 @@
+// Runs the benchmarks, prints a table to stderr and the results as JSON
+//
+// Options:
+//   --filter=<substring>   only run the benchmarks with names containing it
+//   --json=<path>          write the JSON there instead of stdout
+//   --min-time=<ms>        minimum duration of each timed batch
+//   --save=<path>          also benchmark loading a real save, can be repeated
+//   --allocations          also count the heap allocations of one iteration,
+//                          needs a build with ALLOCATION_STATS
+
+#include "harness.h"
+
+#include "AllocationStats.h"
+
+#include <QLoggingCategory>
+
+#include <cerrno>
+#include <cstring>
+
+int main(int argc, char *argv[])
+{
+    benchmark::Suite suite;
+    std::string jsonPath;
+    std::vector<std::string> saveFiles;
+
+    for (int i=1; i<argc; i++) {
+        const std::string argument = argv[i];
+        const size_t separator = argument.find('=');
+        const std::string name = argument.substr(0, separator);
+        const std::string value = separator == std::string::npos ? std::string() : argument.substr(separator + 1);
+
+        if (name == "--filter") {
+            suite.setFilter(value);
+        } else if (name == "--json") {
+            jsonPath = value;
+        } else if (name == "--min-time") {
+            suite.setMinBatchTime(std::max(1., atof(value.c_str())));
+        } else if (name == "--save") {
+            saveFiles.push_back(value);
+        } else if (name == "--allocations") {
+            if (!AllocationStats::isAvailable()) {
+                fprintf(stderr, "--allocations needs a build with -DALLOCATION_STATS=ON\n");
+                return 1;
+            }
+            AllocationStats::setEnabled(true);
+            suite.setCountAllocations(true);
+        } else {
+            fprintf(stderr, "Usage: %s [--filter=<substring>] [--json=<path>] [--min-time=<ms>] [--save=<path>]... [--allocations]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // The parser is chatty, and we want to measure it and not the terminal
+    QLoggingCategory::setFilterRules("*.debug=false\n*.warning=false");
+
+    benchmark::registerCrc32(suite);
+    benchmark::registerBits(suite);
+    benchmark::registerLoad(suite, saveFiles);
+
+    const std::vector<benchmark::Result> results = suite.run();
+
+    FILE *output = stdout;
+    if (!jsonPath.empty()) {
+        output = fopen(jsonPath.c_str(), "w");
+        if (!output) {
+            fprintf(stderr, "Failed to open %s: %s\n", jsonPath.c_str(), strerror(errno));
+            return 1;
+        }
+    }
+    benchmark::Suite::writeJson(output, results);
+    if (output != stdout) {
+        fclose(output);
+    }
+
+    return 0;
+}
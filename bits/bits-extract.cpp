@@ -0,0 +1,127 @@
+/* Licensed under the MIT license: http://www.opensource.org/licenses/mit-license.php */
+#include <stdint.h>
+#include <string.h>
+#include "bits-extract.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BITS_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace bits {
+
+  namespace {
+
+    /* output byte i is the low bits of source byte i and the high bits of byte i+1 */
+    inline unsigned char mergebyte(const unsigned char *src, std::size_t srcsize, std::size_t byte, unsigned shift) {
+      unsigned char a = byte < srcsize ? src[byte] : 0;
+      if (!shift) return a;
+      unsigned char b = byte + 1 < srcsize ? src[byte + 1] : 0;
+      return (unsigned char) ((a << shift) | (b >> (8 - shift)));
+    }
+
+    template<class T> void extract_scalar(T *dst, const unsigned char *src, std::size_t srcsize, std::size_t first,
+                                          unsigned shift, std::size_t i, std::size_t numbytes, unsigned char mask) {
+      for (; i < numbytes; i++) {
+        dst[i] = mergebyte(src, srcsize, first + i, shift) & mask;
+      }
+    }
+
+#if defined(__SSE2__)
+    inline void store_sse2(unsigned char *dst, __m128i v) {
+      _mm_storeu_si128((__m128i *) dst, v);
+    }
+
+    inline void store_sse2(uint16_t *dst, __m128i v) {
+      const __m128i zero = _mm_setzero_si128();
+      _mm_storeu_si128((__m128i *) dst, _mm_unpacklo_epi8(v, zero));
+      _mm_storeu_si128((__m128i *) (dst + 8), _mm_unpackhi_epi8(v, zero));
+    }
+
+    /* SSE2 has no per byte shifts, so shift 16 bit lanes and mask off what crossed over */
+    template<class T> std::size_t extract_sse2(T *dst, const unsigned char *src, std::size_t srcsize, std::size_t first,
+                                               unsigned shift, std::size_t i, std::size_t numbytes, unsigned char mask) {
+      const __m128i sl = _mm_cvtsi32_si128(shift), sr = _mm_cvtsi32_si128(8 - shift);
+      const __m128i lomask = _mm_set1_epi8((char) (0xff << shift));
+      const __m128i himask = _mm_set1_epi8((char) (0xff >> (8 - shift)));
+      const __m128i outmask = _mm_set1_epi8((char) mask);
+      for (; i + 16 <= numbytes && first + i + 17 <= srcsize; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (src + first + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + first + i + 1));
+        __m128i v = _mm_or_si128(_mm_and_si128(_mm_sll_epi16(a, sl), lomask),
+                                 _mm_and_si128(_mm_srl_epi16(b, sr), himask));
+        store_sse2(dst + i, _mm_and_si128(v, outmask));
+      }
+      return i;
+    }
+#endif
+
+#if defined(BITS_HAVE_AVX2)
+    __attribute__((target("avx2"))) inline void store_avx2(unsigned char *dst, __m256i v) {
+      _mm256_storeu_si256((__m256i *) dst, v);
+    }
+
+    __attribute__((target("avx2"))) inline void store_avx2(uint16_t *dst, __m256i v) {
+      _mm256_storeu_si256((__m256i *) dst, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+      _mm256_storeu_si256((__m256i *) (dst + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+    }
+
+    template<class T> __attribute__((target("avx2")))
+    std::size_t extract_avx2(T *dst, const unsigned char *src, std::size_t srcsize, std::size_t first,
+                             unsigned shift, std::size_t i, std::size_t numbytes, unsigned char mask) {
+      const __m128i sl = _mm_cvtsi32_si128(shift), sr = _mm_cvtsi32_si128(8 - shift);
+      const __m256i lomask = _mm256_set1_epi8((char) (0xff << shift));
+      const __m256i himask = _mm256_set1_epi8((char) (0xff >> (8 - shift)));
+      const __m256i outmask = _mm256_set1_epi8((char) mask);
+      for (; i + 32 <= numbytes && first + i + 33 <= srcsize; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (src + first + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (src + first + i + 1));
+        __m256i v = _mm256_or_si256(_mm256_and_si256(_mm256_sll_epi16(a, sl), lomask),
+                                    _mm256_and_si256(_mm256_srl_epi16(b, sr), himask));
+        store_avx2(dst + i, _mm256_and_si256(v, outmask));
+      }
+      return i;
+    }
+
+    bool has_avx2() {
+      static const bool supported = __builtin_cpu_supports("avx2");
+      return supported;
+    }
+#endif
+
+    template<class T> void extract(T *dst, const unsigned char *src, std::size_t srcsize,
+                                   std::size_t bitoffset, std::size_t numbytes, unsigned char mask) {
+      const std::size_t first = bitoffset/8;
+      const unsigned shift = bitoffset%8;
+      std::size_t i = 0;
+#if defined(BITS_HAVE_AVX2)
+      if (numbytes >= 32 && has_avx2()) {
+        i = extract_avx2(dst, src, srcsize, first, shift, i, numbytes, mask);
+      }
+#endif
+#if defined(__SSE2__)
+      i = extract_sse2(dst, src, srcsize, first, shift, i, numbytes, mask);
+#endif
+      extract_scalar(dst, src, srcsize, first, shift, i, numbytes, mask);
+    }
+
+  }
+
+  void extractbytes(unsigned char *dst, const unsigned char *src, std::size_t srcsize,
+                    std::size_t bitoffset, std::size_t numbytes, unsigned char mask) {
+    if (bitoffset%8 == 0 && mask == 0xff && bitoffset/8 + numbytes <= srcsize) {
+      memcpy(dst, src + bitoffset/8, numbytes);
+      return;
+    }
+    extract(dst, src, srcsize, bitoffset, numbytes, mask);
+  }
+
+  void extractwide(uint16_t *dst, const unsigned char *src, std::size_t srcsize,
+                   std::size_t bitoffset, std::size_t numbytes, unsigned char mask) {
+    extract(dst, src, srcsize, bitoffset, numbytes, mask);
+  }
+
+}
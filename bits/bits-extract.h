@@ -0,0 +1,28 @@
+/** -*- mode: c++ -*-
+ *  Licensed under the MIT license: http://www.opensource.org/licenses/mit-license.php
+ */
+#ifndef __BITS__BITS_EXTRACT_H
+#define __BITS__BITS_EXTRACT_H 1
+#include <stdint.h>
+#include <cstddef>
+
+namespace bits {
+
+  /**
+   * Copies numbytes bytes starting at an arbitrary bit offset in src to dst,
+   * ANDing every byte with mask on the way. This is a single shift-merge pass
+   * (SSE2, or AVX2 when the CPU has it), never reading src past srcsize.
+   */
+  void extractbytes(unsigned char *dst, const unsigned char *src, std::size_t srcsize,
+                    std::size_t bitoffset, std::size_t numbytes, unsigned char mask = 0xff);
+
+  /**
+   * Same as extractbytes, but widens every byte to a 16 bit code unit, i.e.
+   * decodes Latin-1 (or ASCII, if mask is 0x7f) straight to UTF-16.
+   */
+  void extractwide(uint16_t *dst, const unsigned char *src, std::size_t srcsize,
+                   std::size_t bitoffset, std::size_t numbytes, unsigned char mask = 0xff);
+
+}
+
+#endif
@@ -0,0 +1,75 @@
+/* Licensed under the MIT license: http://www.opensource.org/licenses/mit-license.php */
+#include <stdint.h>
+#include <string.h>
+#include "bits-reader.h"
+#include "bits-extract.h"
+
+
+namespace bits {
+
+  bitreader::bitreader(const unsigned char *data, std::size_t size) :
+    buffer(data), length(size), nextbyte(0), bits(0), count(0) {
+  }
+
+  void bitreader::refill_tail() {
+    /* byte by byte close to the end, so we never touch memory past it */
+    while (count <= 56) {
+      uint64_t byte = nextbyte < length ? buffer[nextbyte] : 0;
+      bits |= byte << (56 - count);
+      nextbyte++;
+      count += 8;
+    }
+  }
+
+  void bitreader::seek(unsigned position) {
+    nextbyte = position/8;
+    bits = 0;
+    count = 0;
+    refill();
+    bits <<= position%8;
+    count -= position%8;
+  }
+
+  void bitreader::peekstring(unsigned char *dst, int numbits) {
+    bitreader copy = *this;
+    copy.readstring(dst, numbits);
+  }
+
+  std::string bitreader::peekstring(int numbits) {
+    std::string s(numbits/8 + (numbits%8 ? 1 : 0), 0);
+    peekstring((unsigned char *) &s[0], numbits);
+    return std::string(s.c_str());
+  }
+
+  void bitreader::readstring(unsigned char *dst, int numbits) {
+    readbytes(dst, numbits/8);
+    if (numbits%8) {
+      dst[numbits/8] = read<unsigned>(numbits%8);
+    }
+  }
+
+  void bitreader::readbytes(unsigned char *dst, std::size_t numbytes, unsigned char mask) {
+    unsigned current_offset = position();
+    extractbytes(dst, buffer, length, current_offset, numbytes, mask);
+    seek(current_offset + numbytes*8);
+  }
+
+  void bitreader::readwide(uint16_t *dst, std::size_t numbytes, unsigned char mask) {
+    unsigned current_offset = position();
+    extractwide(dst, buffer, length, current_offset, numbytes, mask);
+    seek(current_offset + numbytes*8);
+  }
+
+  std::string bitreader::readstring(int numbits) {
+    std::string s = peekstring(numbits);
+    skip(numbits);
+    return s;
+  }
+
+  void bitreader::readstring_at(unsigned char *dst, int offset, int numbits) {
+    bitreader copy = *this;
+    copy.seek(offset);
+    copy.readstring(dst, numbits);
+  }
+
+}
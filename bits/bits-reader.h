@@ -0,0 +1,115 @@
+/** -*- mode: c++ -*-
+ *  Licensed under the MIT license: http://www.opensource.org/licenses/mit-license.php
+ */
+#ifndef __BITS__BITS_READER_H
+#define __BITS__BITS_READER_H 1
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+#include "bits.h"
+
+namespace bits {
+
+  /**
+   * Reads MSB first bit fields like bitstream, but keeps up to 64 bits
+   * buffered in a register. The register is refilled with a single unaligned
+   * big endian load, and fields are extracted with shifts.
+   *
+   * Unlike bitstream it knows the size of the buffer and never reads past
+   * it, bits past the end read as zero (check overrun() afterwards).
+   */
+  class bitreader {
+    const unsigned char * buffer;
+    std::size_t length;
+    std::size_t nextbyte; // next byte to be loaded into the register
+    uint64_t bits;        // left aligned, the top bit is at position()
+    unsigned count;       // number of valid bits in the register
+
+    static inline uint64_t load64be(const unsigned char *p) {
+      uint64_t v;
+      ::memcpy(&v, p, sizeof(v));
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      v = __builtin_bswap64(v);
+#elif !defined(__GNUC__)
+      v = 0;
+      for (int i=0; i<8; i++) v = (v << 8) | p[i];
+#endif
+      return v;
+    }
+
+    inline void refill() {
+      if (nextbyte + 8 <= length) {
+        bits |= load64be(buffer + nextbyte) >> count;
+        nextbyte += (63 - count) >> 3;
+        count |= 56;
+      } else {
+        refill_tail();
+      }
+    }
+
+    void refill_tail();
+
+  public:
+    bitreader(const unsigned char *data, std::size_t size);
+
+    const unsigned char * ptr() const { return buffer; }
+    std::size_t size() const { return length; }
+    bool aligned() const { return position()%8 == 0; }
+
+    /* true if we have read past the end of the buffer */
+    bool overrun() const { return position() > length*8; }
+
+    void seek(unsigned position);
+    void rewind() { seek(0); }
+    void skip(int numbits) {
+      if (numbits >= 0 && unsigned(numbits) < count) {
+        bits <<= numbits;
+        count -= numbits;
+      } else {
+        seek(position() + numbits);
+      }
+    }
+    unsigned position() const { return nextbyte*8 - count; }
+
+    template<class T> T read(int numbits) {
+      BITS_T_ASSERT(T);
+      if (numbits <= 0) return 0;
+      if (numbits > 56) {
+        /* a refill only guarantees 56 bits, so split the big ones */
+        uint64_t hi = read<uint64_t>(numbits - 32);
+        return (T) ((hi << 32) | read<uint64_t>(32));
+      }
+      if (count < (unsigned) numbits) refill();
+      uint64_t v = bits >> (64 - numbits);
+      bits <<= numbits;
+      count -= numbits;
+      return (T) v;
+    }
+
+    template<class T> T peek(int numbits) {
+      bitreader copy = *this;
+      return copy.read<T>(numbits);
+    }
+
+    template<class T> T read_at(int offset, int numbits) {
+      bitreader copy = *this;
+      copy.seek(offset);
+      return copy.read<T>(numbits);
+    }
+
+    void readstring_at(unsigned char *dst, int offset, int numbits);
+    void readstring(unsigned char *dst, int numbits);
+    std::string readstring(int numbits);
+    void peekstring(unsigned char *dst, int numbits);
+    std::string peekstring(int numbits);
+
+    /* numbytes whole bytes from the current position, each one ANDed with mask */
+    void readbytes(unsigned char *dst, std::size_t numbytes, unsigned char mask = 0xff);
+    /* same, but widened to 16 bit code units (Latin-1 to UTF-16) */
+    void readwide(uint16_t *dst, std::size_t numbytes, unsigned char mask = 0xff);
+  };
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 #include <stdint.h>
 #include <string.h>
 #include "bits-stream.h"
+#include "bits-extract.h"
 
 
 namespace bits {
@@ -22,11 +23,12 @@ namespace bits {
   void bitstream::peekstring(unsigned char *dst, int numbits) {
     unsigned current_offset = position();
     if ( position()%8 || numbits%8 ) {
-      while (numbits > 0) {
-	*(dst++) = read<unsigned> ( std::min(numbits,8) );
-	numbits -= 8;
+      /* the buffer size is unknown, so only let it touch the bytes we need */
+      std::size_t numbytes = numbits/8;
+      extractbytes(dst, buffer, current_offset/8 + numbytes + 1, current_offset, numbytes);
+      if (numbits%8) {
+	dst[numbytes] = read_at<unsigned> ( current_offset + numbytes*8, numbits%8 );
       }
-      seek(current_offset);
     } else {
       memcpy (dst, (buffer + current_offset/8), numbits/8);
     }
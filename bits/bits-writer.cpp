@@ -0,0 +1,74 @@
+/* Licensed under the MIT license: http://www.opensource.org/licenses/mit-license.php */
+#include <stdint.h>
+#include <string.h>
+#include "bits-writer.h"
+
+
+namespace bits {
+
+  bitwriter::bitwriter(std::size_t reserve) : bits(0), count(0) {
+    buffer.reserve(reserve);
+  }
+
+  void bitwriter::flushbytes() {
+    /* move the complete bytes out of the register */
+    while (count >= 8) {
+      buffer.push_back((unsigned char) (bits >> 56));
+      bits <<= 8;
+      count -= 8;
+    }
+  }
+
+  void bitwriter::writestring(int numbits, const unsigned char *src) {
+    writebytes(src, numbits/8);
+    if (numbits%8) {
+      write<unsigned> ( numbits%8, src[numbits/8] );
+    }
+  }
+
+  void bitwriter::writestring(std::string s, int max_bytes) {
+    writestring ( std::min(max_bytes*8, (int) s.size() * 8), (const unsigned char *) s.c_str() );
+    if (max_bytes > (int) s.size()) zero ( (max_bytes - s.size()) * 8 );
+  }
+
+  void bitwriter::writestring(std::string s) {
+    writestring (s, s.size() );
+  }
+
+  void bitwriter::writebytes(const unsigned char *src, std::size_t numbytes) {
+    if (count%8) {
+      /* not aligned, goes through the register */
+      while (numbytes--) {
+	write<unsigned> ( 8, *(src++) );
+      }
+      return;
+    }
+    flushbytes();
+    buffer.insert(buffer.end(), src, src + numbytes);
+  }
+
+  void bitwriter::zero(int numbits) {
+    while (numbits > 0) {
+      write<uint64_t> ( std::min(numbits, 64), 0 );
+      numbits -= 64;
+    }
+  }
+
+  void bitwriter::align() {
+    if (count%8) write<unsigned> ( 8 - count%8, 0 );
+  }
+
+  const std::vector<unsigned char> &bitwriter::data() {
+    align();
+    flushbytes();
+    return buffer;
+  }
+
+  std::vector<unsigned char> bitwriter::take() {
+    data();
+    std::vector<unsigned char> ret;
+    ret.swap(buffer);
+    return ret;
+  }
+
+}
@@ -0,0 +1,90 @@
+/** -*- mode: c++ -*-
+ *  Licensed under the MIT license: http://www.opensource.org/licenses/mit-license.php
+ */
+#ifndef __BITS__BITS_WRITER_H
+#define __BITS__BITS_WRITER_H 1
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "bits.h"
+
+namespace bits {
+
+  /**
+   * Writes MSB first bit fields, the counterpart of bitreader.
+   *
+   * Bits are collected in a 64 bit register and flushed a whole big endian
+   * word at a time into a buffer that grows as needed, so there's no read
+   * modify write of memory per field like with bitstream::write.
+   */
+  class bitwriter {
+    std::vector<unsigned char> buffer; // only whole flushed words and bytes
+    uint64_t bits;                     // pending bits, left aligned
+    unsigned count;                    // number of pending bits, always < 64
+
+    inline void flushword() {
+      std::size_t end = buffer.size();
+      buffer.resize(end + 8);
+      uint64_t v = bits;
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      v = __builtin_bswap64(v);
+      ::memcpy(&buffer[end], &v, sizeof(v));
+#else
+      for (int i=0; i<8; i++) buffer[end + i] = (unsigned char) (v >> (56 - 8*i));
+#endif
+      bits = 0;
+      count = 0;
+    }
+
+    void flushbytes();
+
+  public:
+    bitwriter(std::size_t reserve = 0);
+
+    bool aligned() const { return count%8 == 0; }
+    unsigned position() const { return buffer.size()*8 + count; }
+    /* size in bytes, including a partially written last byte */
+    std::size_t size() const { return buffer.size() + (count + 7)/8; }
+
+    /* Writes the numbits least significant bits of v */
+    template<class T> void write(int numbits, T v) {
+      BITS_T_ASSERT(T);
+      if (numbits <= 0) return;
+      uint64_t value = (uint64_t) v;
+      if (numbits < 64) value &= ~(~(uint64_t) 0 << numbits);
+
+      if (count + numbits < 64) {
+        bits |= value << (64 - count - numbits);
+        count += numbits;
+      } else {
+        unsigned remaining = count + numbits - 64;
+        bits |= value >> remaining;
+        flushword();
+        if (remaining) {
+          bits = value << (64 - remaining);
+          count = remaining;
+        }
+      }
+    }
+
+    void writestring(int numbits, const unsigned char *src);
+    void writestring(std::string s);
+    void writestring(std::string s, int max_bytes);
+
+    /* numbytes whole bytes, a plain memcpy when the writer is byte aligned */
+    void writebytes(const unsigned char *src, std::size_t numbytes);
+
+    void zero(int numbits);
+    /* pads with zero bits up to the next byte boundary */
+    void align();
+
+    /* Everything written so far, aligns the writer first so a partial last byte is zero padded */
+    const std::vector<unsigned char> &data();
+    std::vector<unsigned char> take();
+  };
+
+}
+
+#endif
@@ -0,0 +1,410 @@
+#include "SaveFile.h"
+#include "SaveIndex.h"
+#include "SaveTrace.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+
+namespace {
+
+struct Result {
+    QByteArray json; // one line, including the newline
+    qint64 size = 0;
+    bool ok = false;
+};
+
+QJsonObject headerToJson(const SaveHeader &header)
+{
+    QJsonObject values;
+    for (int i=0; i<SaveHeader::NumEntries; i++) {
+        const SaveHeader::EntryId id = SaveHeader::EntryId(i);
+        values[QLatin1String(SaveHeader::keyName(id))] = header.value(id);
+    }
+
+    QJsonObject json;
+    json["version"] = header.m_version;
+    json["values"] = values;
+    if (header.m_unknownEntries) {
+        json["unknownEntries"] = header.m_unknownEntries;
+    }
+    if (header.m_entriesReordered) {
+        json["entriesReordered"] = true;
+    }
+    if (header.m_keyedByPosition) {
+        json["keyedByPosition"] = true;
+    }
+    return json;
+}
+
+QJsonObject dataToJson(const SaveData &data)
+{
+    QJsonObject json;
+    json["timestamp"] = data.m_timestamp.toString(Qt::ISODate);
+    json["saveFileName"] = data.saveFileName();
+    json["gameVersion"] = data.m_gameVersion;
+    json["saveVersion"] = data.m_saveVersion;
+    json["unknown1"] = data.m_unknown1;
+    json["unknown2"] = data.m_unknown2;
+    json["unknown3"] = qint64(data.m_unknown3);
+    json["userBuildInfo"] = qint64(data.m_userBuildInfo);
+    json["levelName"] = data.levelName();
+    json["preloadedBundles"] = QJsonArray::fromStringList(data.preloadedBundles());
+    return json;
+}
+
+QJsonObject countersToJson(const AllocationStats::Counters &counters)
+{
+    QJsonObject json;
+    json["allocations"] = qint64(counters.allocations);
+    json["bytes"] = qint64(counters.bytes);
+    json["peak"] = qint64(counters.peak);
+    return json;
+}
+
+QJsonObject allocationsToJson(const SaveFile &saveFile)
+{
+    QJsonObject json;
+    json["total"] = countersToJson(saveFile.loadAllocations());
+    for (int i=0; i<SaveFile::NumStages; i++) {
+        const SaveFile::Stage stage = SaveFile::Stage(i);
+        json[enumToString(stage)] = countersToJson(saveFile.allocations(stage));
+    }
+    return json;
+}
+
+Result parse(const QString &path, SaveTrace *trace)
+{
+    Result result;
+    result.size = QFileInfo(path).size();
+
+    QJsonObject json;
+    json["path"] = path;
+
+    SaveFile saveFile;
+    saveFile.setTrace(trace);
+    result.ok = saveFile.load(path);
+    json["ok"] = result.ok;
+    if (result.ok) {
+        json["header"] = headerToJson(saveFile.header());
+        json["data"] = dataToJson(saveFile.data());
+    }
+    if (AllocationStats::isEnabled()) {
+        json["allocations"] = allocationsToJson(saveFile);
+    }
+
+    result.json = QJsonDocument(json).toJson(QJsonDocument::Compact);
+    result.json += '\n';
+    return result;
+}
+
+// Loads, writes back out and compares with the original
+Result verify(const QString &path, SaveTrace *trace)
+{
+    Result result;
+
+    QJsonObject json;
+    json["path"] = path;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        json["ok"] = false;
+        json["error"] = file.errorString();
+        result.json = QJsonDocument(json).toJson(QJsonDocument::Compact) + '\n';
+        return result;
+    }
+    const QByteArray original = file.readAll();
+    result.size = original.size();
+
+    SaveFile saveFile;
+    saveFile.setTrace(trace);
+    QByteArray written;
+    if (!saveFile.load(original.constData(), original.size())) {
+        json["error"] = QStringLiteral("load failed");
+    } else if (!saveFile.save(&written)) {
+        json["error"] = QStringLiteral("save failed");
+    } else if (written == original) {
+        result.ok = true;
+    } else {
+        qint64 firstDifference = qint64(qMin(original.size(), written.size())) * 8;
+        for (int i=0; i<qMin(original.size(), written.size()); i++) {
+            const quint8 difference = quint8(original[i] ^ written[i]);
+            if (difference) {
+                // Bits are counted MSB first, like in the bit reader
+                int bit = 0;
+                while (!(difference & (0x80 >> bit))) {
+                    bit++;
+                }
+                firstDifference = qint64(i) * 8 + bit;
+                break;
+            }
+        }
+
+        // Rare enough that loading again to find the field is fine
+        SaveFile traced;
+        traced.setRecordFieldOffsets(true);
+        traced.load(original.constData(), original.size());
+        const char *field = traced.fieldAt(firstDifference);
+
+        json["firstDifferentBit"] = firstDifference;
+        json["field"] = field ? QString::fromLatin1(field) : QString();
+        json["originalSize"] = original.size();
+        json["writtenSize"] = written.size();
+    }
+
+    json["ok"] = result.ok;
+    if (!json.contains("error")) {
+        json["endian"] = saveFile.header().m_endian == QSysInfo::BigEndian ? "big" : "little";
+        json["saveVersion"] = saveFile.data().m_saveVersion;
+    }
+
+    result.json = QJsonDocument(json).toJson(QJsonDocument::Compact);
+    result.json += '\n';
+    return result;
+}
+
+// Changes fields in place, only the bytes of the fields and the checksums are written
+Result patch(const QString &path, const QVector<QPair<QByteArray, QString>> &assignments, SaveTrace *trace)
+{
+    Result result;
+    result.size = QFileInfo(path).size();
+
+    QJsonObject json;
+    json["path"] = path;
+
+    QFile file(path);
+    SaveFile saveFile;
+    saveFile.setRecordFieldOffsets(true);
+    saveFile.setTrace(trace);
+    if (!file.open(QIODevice::ReadWrite)) {
+        json["error"] = file.errorString();
+    } else if (!saveFile.load(&file)) {
+        json["error"] = QStringLiteral("load failed");
+    } else {
+        result.ok = true;
+        for (const QPair<QByteArray, QString> &assignment : assignments) {
+            bool isNumber = false;
+            const quint64 number = assignment.second.toULongLong(&isNumber);
+            const QDateTime date = isNumber ? QDateTime() : QDateTime::fromString(assignment.second, Qt::ISODate);
+            if (!isNumber && !date.isValid()) {
+                json["error"] = QStringLiteral("not a number or an ISO date: ") + assignment.second;
+                result.ok = false;
+                break;
+            }
+            const bool patched = isNumber ?
+                saveFile.patch(&file, assignment.first.constData(), number) :
+                saveFile.patch(&file, assignment.first.constData(), date);
+            if (!patched) {
+                json["error"] = QStringLiteral("failed to set ") + QString::fromLatin1(assignment.first);
+                result.ok = false;
+                break;
+            }
+        }
+    }
+
+    json["ok"] = result.ok;
+    result.json = QJsonDocument(json).toJson(QJsonDocument::Compact);
+    result.json += '\n';
+    return result;
+}
+
+QJsonObject indexEntryToJson(const SaveIndex::Entry &entry)
+{
+    QJsonObject json;
+    json["path"] = entry.path;
+    json["ok"] = entry.isValid;
+    if (!entry.isValid) {
+        return json;
+    }
+
+    QJsonObject values;
+    for (int i=0; i<SaveHeader::NumEntries && i<entry.headerValues.count(); i++) {
+        values[QLatin1String(SaveHeader::keyName(SaveHeader::EntryId(i)))] = entry.headerValues[i];
+    }
+    json["header"] = values;
+
+    QJsonObject data;
+    data["timestamp"] = entry.timestamp.toString(Qt::ISODate);
+    data["saveFileName"] = entry.saveFileName;
+    data["gameVersion"] = entry.gameVersion;
+    data["saveVersion"] = entry.saveVersion;
+    data["levelName"] = entry.levelName;
+    json["data"] = data;
+    return json;
+}
+
+// Lists the saves in each directory from its index, only the ones that have
+// changed since the last run are parsed. The index is updated afterwards.
+int listIndexed(const QStringList &directories)
+{
+    int failed = 0;
+    for (const QString &directory : directories) {
+        if (!QFileInfo(directory).isDir()) {
+            fprintf(stderr, "--index needs directories, %s is not one\n", qPrintable(directory));
+            return 1;
+        }
+
+        const QString indexPath = SaveIndex::defaultIndexPath(directory);
+        SaveIndex index;
+        index.load(indexPath);
+        const int parsed = index.update(directory);
+        index.save(indexPath);
+
+        QList<QString> paths = index.entries().keys();
+        std::sort(paths.begin(), paths.end());
+        for (const QString &path : paths) {
+            const SaveIndex::Entry entry = index.entries().value(path);
+            const QByteArray json = QJsonDocument(indexEntryToJson(entry)).toJson(QJsonDocument::Compact) + '\n';
+            fwrite(json.constData(), 1, json.size(), stdout);
+            if (!entry.isValid) {
+                failed++;
+            }
+        }
+        fprintf(stderr, "%s: %d saves, %d parsed\n", qPrintable(directory), int(paths.count()), parsed);
+    }
+    fflush(stdout);
+
+    return failed ? 1 : 0;
+}
+
+QStringList collectFiles(const QStringList &paths)
+{
+    QStringList files;
+    for (const QString &path : paths) {
+        if (!QFileInfo(path).isDir()) {
+            files.append(path);
+            continue;
+        }
+        QDirIterator it(path, QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            files.append(it.next());
+        }
+    }
+    return files;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("masseffectandromeda-save-cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Parses saves and writes one JSON object per line to stdout");
+    parser.addHelpOption();
+    parser.addPositionalArgument("paths", "Save files, or directories to search for saves", "<paths...>");
+    QCommandLineOption jobsOption({"j", "jobs"}, "Number of worker threads", "count");
+    parser.addOption(jobsOption);
+    QCommandLineOption verboseOption({"v", "verbose"}, "Print the parser debug output, not available in Release builds");
+    parser.addOption(verboseOption);
+    QCommandLineOption verifyOption("verify", "Check that writing each save back out gives the same bytes, "
+                                    "prints where the first difference is if not");
+    parser.addOption(verifyOption);
+    QCommandLineOption traceOption("trace", "Write how long each stage of loading took, "
+                                   "in the Chrome trace format (chrome://tracing, Perfetto)", "path");
+    parser.addOption(traceOption);
+    QCommandLineOption allocationsOption("allocations", "Count the heap allocations of each stage of loading each save, "
+                                         "needs a build with ALLOCATION_STATS");
+    parser.addOption(allocationsOption);
+    QCommandLineOption indexOption("index", "List the saves in each directory from an index kept in it, "
+                                   "only parsing the ones that changed since the last time");
+    parser.addOption(indexOption);
+    QCommandLineOption setOption("set", "Change a fixed width field in place, as a number or an ISO date. "
+                                 "Can be given more than once.", "field=value");
+    parser.addOption(setOption);
+    parser.process(app);
+
+    if (parser.positionalArguments().isEmpty()) {
+        parser.showHelp(1);
+    }
+    if (!parser.isSet(verboseOption)) {
+        QLoggingCategory::setFilterRules("*.debug=false");
+    } else {
+        QLoggingCategory::setFilterRules("mea.save.*.debug=true");
+    }
+    if (parser.isSet(allocationsOption)) {
+        if (!AllocationStats::isAvailable()) {
+            fprintf(stderr, "--allocations needs a build with -DALLOCATION_STATS=ON\n");
+            return 1;
+        }
+        AllocationStats::setEnabled(true);
+    }
+    if (parser.isSet(jobsOption)) {
+        QThreadPool::globalInstance()->setMaxThreadCount(qMax(1, parser.value(jobsOption).toInt()));
+    }
+
+    if (parser.isSet(indexOption)) {
+        if (parser.isSet(setOption) || parser.isSet(verifyOption) || parser.isSet(traceOption) || parser.isSet(allocationsOption)) {
+            fprintf(stderr, "--index can't be combined with --set, --verify, --trace or --allocations\n");
+            return 1;
+        }
+        return listIndexed(parser.positionalArguments());
+    }
+
+    QVector<QPair<QByteArray, QString>> assignments;
+    for (const QString &assignment : parser.values(setOption)) {
+        const int separator = assignment.indexOf('=');
+        if (separator <= 0) {
+            fprintf(stderr, "Invalid --set %s, expected field=value\n", qPrintable(assignment));
+            return 1;
+        }
+        assignments.append(qMakePair(assignment.left(separator).toLatin1(), assignment.mid(separator + 1)));
+    }
+
+    SaveTrace trace;
+    SaveTrace *tracePtr = parser.isSet(traceOption) ? &trace : nullptr;
+
+    std::function<Result(const QString&)> function = [tracePtr](const QString &path) { return parse(path, tracePtr); };
+    if (!assignments.isEmpty()) {
+        function = [assignments, tracePtr](const QString &path) { return patch(path, assignments, tracePtr); };
+    } else if (parser.isSet(verifyOption)) {
+        function = [tracePtr](const QString &path) { return verify(path, tracePtr); };
+    }
+
+    const QStringList files = collectFiles(parser.positionalArguments());
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Idle workers pick up the next file as soon as they're done, so a few
+    // big saves don't hold up the rest. Results are written in input order.
+    QFuture<Result> results = QtConcurrent::mapped(files, function);
+
+    qint64 totalBytes = 0;
+    int failed = 0;
+    // Not a range-for, QFuture's iterators don't wait for the results in Qt 5
+    for (int i=0; i<files.count(); i++) {
+        const Result result = results.resultAt(i);
+        fwrite(result.json.constData(), 1, result.json.size(), stdout);
+        totalBytes += result.size;
+        if (!result.ok) {
+            failed++;
+        }
+    }
+    fflush(stdout);
+
+    const double seconds = qMax(timer.nsecsElapsed(), qint64(1)) / 1e9;
+    fprintf(stderr, "%d files (%d failed), %.1f MB in %.3f s: %.1f files/s, %.1f MB/s\n",
+            int(files.count()), failed, totalBytes / 1e6, seconds,
+            files.count() / seconds, totalBytes / 1e6 / seconds);
+
+    if (tracePtr && !trace.save(parser.value(traceOption))) {
+        return 1;
+    }
+
+    return failed ? 1 : 0;
+}
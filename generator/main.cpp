@@ -0,0 +1,99 @@
+#include "SaveGenerator.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <atomic>
+#include <cstdio>
+#include <numeric>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("masseffectandromeda-save-generator");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Writes saves with valid checksums and random contents");
+    parser.addHelpOption();
+    parser.addPositionalArgument("directory", "Where to put the saves");
+    QCommandLineOption countOption({"n", "count"}, "Number of saves", "count", "100");
+    parser.addOption(countOption);
+    QCommandLineOption seedOption({"s", "seed"}, "Same seed, same saves", "seed", "1337");
+    parser.addOption(seedOption);
+    QCommandLineOption endianOption("endian", "little, big or mixed", "endian", "mixed");
+    parser.addOption(endianOption);
+    QCommandLineOption sizeOption("size", "Bytes of random data after the parsed fields in each save", "bytes", "2097152");
+    parser.addOption(sizeOption);
+    QCommandLineOption bundlesOption("bundles", "Number of preloaded bundle strings", "count", "64");
+    parser.addOption(bundlesOption);
+    QCommandLineOption minLengthOption("min-bundle-length", "Shortest preloaded bundle string", "length", "8");
+    parser.addOption(minLengthOption);
+    QCommandLineOption maxLengthOption("max-bundle-length", "Longest preloaded bundle string, at most 1000", "length", "64");
+    parser.addOption(maxLengthOption);
+    QCommandLineOption jobsOption({"j", "jobs"}, "Number of worker threads", "count");
+    parser.addOption(jobsOption);
+    parser.process(app);
+
+    if (parser.positionalArguments().count() != 1) {
+        parser.showHelp(1);
+    }
+    const QString endian = parser.value(endianOption);
+    if (endian != "little" && endian != "big" && endian != "mixed") {
+        fprintf(stderr, "Invalid endianness %s\n", qPrintable(endian));
+        return 1;
+    }
+    if (parser.isSet(jobsOption)) {
+        QThreadPool::globalInstance()->setMaxThreadCount(qMax(1, parser.value(jobsOption).toInt()));
+    }
+
+    const QDir directory(parser.positionalArguments().first());
+    if (!directory.mkpath(".")) {
+        fprintf(stderr, "Failed to create %s\n", qPrintable(directory.path()));
+        return 1;
+    }
+
+    SaveGenerator::Options options;
+    options.remainderSize = qMax(qint64(0), parser.value(sizeOption).toLongLong());
+    options.bundleCount = qBound(0, parser.value(bundlesOption).toInt(), 0xffff);
+    options.minBundleLength = qMax(0, parser.value(minLengthOption).toInt());
+    options.maxBundleLength = qMax(options.minBundleLength, parser.value(maxLengthOption).toInt());
+
+    const quint64 seed = parser.value(seedOption).toULongLong();
+    const int count = parser.value(countOption).toInt();
+    QVector<int> indices(count);
+    std::iota(indices.begin(), indices.end(), 0);
+
+    // Generating is the slow part, so every file is done in one go on its own thread
+    std::atomic<qint64> totalBytes{0};
+    std::atomic<int> failed{0};
+    QElapsedTimer timer;
+    timer.start();
+
+    QtConcurrent::blockingMap(indices, [&](const int index) {
+        const quint64 fileSeed = SaveGenerator::fileSeed(seed, index);
+        SaveGenerator::Options fileOptions = options;
+        if (endian == "big" || (endian == "mixed" && (fileSeed & 1))) {
+            fileOptions.endian = QSysInfo::BigEndian;
+        }
+        const QByteArray save = SaveGenerator::generate(fileOptions, fileSeed);
+
+        QFile file(directory.filePath(QString::asprintf("Career%08d-0AutoSave", index)));
+        if (save.isEmpty() || !file.open(QIODevice::WriteOnly) || file.write(save) != save.size()) {
+            qWarning() << "Failed to write" << file.fileName();
+            failed++;
+            return;
+        }
+        totalBytes += save.size();
+    });
+
+    const double seconds = qMax(timer.nsecsElapsed(), qint64(1)) / 1e9;
+    fprintf(stderr, "%d saves (%d failed), %.1f MB in %.3f s: %.1f MB/s\n",
+            count, int(failed), totalBytes / 1e6, seconds, totalBytes / 1e6 / seconds);
+
+    return failed ? 1 : 0;
+}
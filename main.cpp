@@ -6,6 +6,14 @@ int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
     MainWindow w;
+
+    // --watch <directory> to follow the autosaves while the game is running
+    const QStringList arguments = a.arguments();
+    const int watchIndex = arguments.indexOf("--watch");
+    if (watchIndex != -1 && watchIndex + 1 < arguments.size()) {
+        w.watchDirectory(arguments[watchIndex + 1]);
+    }
+
     w.show();
     return a.exec();
 }
@@ -0,0 +1,109 @@
+#include "Arena.h"
+
+#include <QtTest>
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+class TestArena : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void allocate();
+    void resetKeepsRegularBlock();
+    void resetAfterOnlyBigAllocations();
+    void move();
+};
+
+namespace {
+
+bool isAligned(const void *pointer, const size_t alignment)
+{
+    return (reinterpret_cast<uintptr_t>(pointer) & (alignment - 1)) == 0;
+}
+
+} // namespace
+
+void TestArena::allocate()
+{
+    Arena arena(256);
+
+    // Filled with their index, nothing may overwrite another one
+    std::vector<std::pair<uchar*, size_t>> allocations;
+    for (size_t i=0; i<200; i++) {
+        const size_t size = (i * 37) % 300 + 1; // some bigger than a block
+        const size_t alignment = size_t(1) << (i % 5);
+        uchar *data = static_cast<uchar*>(arena.allocate(size, alignment));
+        QVERIFY(data);
+        QVERIFY(isAligned(data, alignment));
+        memset(data, int(i), size);
+        allocations.push_back({data, size});
+    }
+    for (size_t i=0; i<allocations.size(); i++) {
+        for (size_t j=0; j<allocations[i].second; j++) {
+            QCOMPARE(int(allocations[i].first[j]), int(uchar(i)));
+        }
+    }
+}
+
+// A big allocation while the first regular block is the current one used to
+// be put in front of it, and reset() then threw away the regular one
+void TestArena::resetKeepsRegularBlock()
+{
+    Arena arena(256);
+    arena.allocate(16);
+    QCOMPARE(arena.bytesAllocated(), size_t(256));
+    arena.allocate(1000);
+    QVERIFY(arena.bytesAllocated() > 256 + 1000);
+
+    arena.reset();
+    QCOMPARE(arena.bytesAllocated(), size_t(256));
+
+    // Reuses the kept block instead of allocating a new one
+    arena.allocate(200);
+    QCOMPARE(arena.bytesAllocated(), size_t(256));
+}
+
+void TestArena::resetAfterOnlyBigAllocations()
+{
+    Arena arena(256);
+    arena.allocate(1000);
+    arena.allocate(2000);
+    arena.reset();
+    QCOMPARE(arena.bytesAllocated(), size_t(0));
+
+    arena.allocate(16);
+    QCOMPARE(arena.bytesAllocated(), size_t(256));
+}
+
+void TestArena::move()
+{
+    Arena arena(256);
+    char *kept = static_cast<char*>(arena.allocate(4));
+    memcpy(kept, "abc", 4);
+    arena.allocate(1000);
+
+    Arena moved(std::move(arena));
+    QCOMPARE(arena.bytesAllocated(), size_t(0));
+    QVERIFY(moved.bytesAllocated() > 256 + 1000);
+    QCOMPARE(QByteArray(kept), QByteArray("abc"));
+
+    // The moved from one starts over, without touching the other's blocks
+    char *other = static_cast<char*>(arena.allocate(4));
+    memcpy(other, "xyz", 4);
+    QCOMPARE(arena.bytesAllocated(), size_t(256));
+    QCOMPARE(QByteArray(kept), QByteArray("abc"));
+
+    Arena assigned;
+    assigned = std::move(moved);
+    QCOMPARE(moved.bytesAllocated(), size_t(0));
+    assigned.reset();
+    QCOMPARE(assigned.bytesAllocated(), size_t(256));
+    QCOMPARE(QByteArray(other), QByteArray("xyz"));
+}
+
+QTEST_GUILESS_MAIN(TestArena)
+#include "tst_arena.moc"
@@ -0,0 +1,172 @@
+#include "Crc32.h"
+
+#include <QtTest>
+
+#include <random>
+#include <vector>
+
+// The bitwise implementation the save files were originally checked with
+static quint32 referenceCrc32(const uchar *data, const size_t length, const quint32 seed)
+{
+    quint32 crc32 = ~seed;
+    for (size_t i=0; i<length; i++) {
+        quint32 val = (crc32 ^ data[i]) & 0xff;
+        for (int bit=0; bit<8; bit++) {
+            val = (val & 1) ? (val >> 1) ^ 0xedb88320 : val >> 1;
+        }
+        crc32 = val ^ (crc32 >> 8);
+    }
+    return ~crc32;
+}
+
+class TestCrc32 : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void knownValue();
+
+    void sliceBy16();
+    void sliceBy16_data() { engines_data(); }
+    void pclmul();
+    void pclmul_data() { engines_data(); }
+    void calculate();
+    void calculate_data() { engines_data(); }
+    void parallel();
+    void parallel_data() { engines_data(); }
+
+    void combine();
+    void update();
+
+private:
+    void engines_data();
+
+    std::vector<uchar> m_buffer;
+};
+
+void TestCrc32::initTestCase()
+{
+    // Room for the biggest length at the biggest offset
+    m_buffer.resize(1024 * 1024 + 64);
+    std::mt19937 random(1337);
+    for (uchar &c : m_buffer) {
+        c = uchar(random());
+    }
+}
+
+void TestCrc32::knownValue()
+{
+    static const char check[] = "123456789";
+    const uchar *data = reinterpret_cast<const uchar*>(check);
+    QCOMPARE(referenceCrc32(data, 9, 0), quint32(0xcbf43926));
+    QCOMPARE(crc32::calculate(data, 9, 0), quint32(0xcbf43926));
+}
+
+// Odd lengths around the 16 and 64 byte blocks of the fast paths, at
+// unaligned starts, with the seed the saves use and with zero
+void TestCrc32::engines_data()
+{
+    QTest::addColumn<int>("offset");
+    QTest::addColumn<int>("length");
+    QTest::addColumn<quint32>("seed");
+
+    static const int lengths[] = { 0, 1, 3, 7, 15, 16, 17, 31, 63, 64, 65, 127, 129, 255, 1023, 4097, 65537, 1024 * 1024 + 7 };
+    static const int offsets[] = { 0, 1, 3, 7, 13 };
+    for (const quint32 seed : { quint32(0x12345678), quint32(0) }) {
+        for (const int length : lengths) {
+            for (const int offset : offsets) {
+                QTest::addRow("seed %08x, %d bytes at +%d", seed, length, offset) << offset << length << seed;
+            }
+        }
+    }
+}
+
+void TestCrc32::sliceBy16()
+{
+    QFETCH(int, offset);
+    QFETCH(int, length);
+    QFETCH(quint32, seed);
+
+    const uchar *data = m_buffer.data() + offset;
+    QCOMPARE(crc32::calculateSliceBy16(data, length, seed), referenceCrc32(data, length, seed));
+}
+
+void TestCrc32::pclmul()
+{
+    if (!crc32::hasPclmul()) {
+        QSKIP("The CPU doesn't have PCLMULQDQ");
+    }
+
+    QFETCH(int, offset);
+    QFETCH(int, length);
+    QFETCH(quint32, seed);
+
+    const uchar *data = m_buffer.data() + offset;
+    QCOMPARE(crc32::calculatePclmul(data, length, seed), referenceCrc32(data, length, seed));
+}
+
+void TestCrc32::calculate()
+{
+    QFETCH(int, offset);
+    QFETCH(int, length);
+    QFETCH(quint32, seed);
+
+    const uchar *data = m_buffer.data() + offset;
+    QCOMPARE(crc32::calculate(data, length, seed), referenceCrc32(data, length, seed));
+}
+
+void TestCrc32::parallel()
+{
+    QFETCH(int, offset);
+    QFETCH(int, length);
+    QFETCH(quint32, seed);
+
+    // Small chunks, so the results of several get combined
+    const uchar *data = m_buffer.data() + offset;
+    QCOMPARE(crc32::calculateParallel(data, length, seed, 1000), referenceCrc32(data, length, seed));
+}
+
+void TestCrc32::combine()
+{
+    const uchar *data = m_buffer.data();
+    const size_t length = 70001;
+    const quint32 whole = referenceCrc32(data, length, 0x12345678);
+    for (const size_t split : { size_t(0), size_t(1), size_t(15), size_t(4096), length - 1, length }) {
+        const quint32 first = crc32::calculate(data, split, 0x12345678);
+        const quint32 second = crc32::calculate(data + split, length - split, 0);
+        QCOMPARE(crc32::combine(first, second, length - split), whole);
+    }
+}
+
+// What SaveFile::patch() relies on, fixing up a checksum from just the changed bytes
+void TestCrc32::update()
+{
+    const size_t length = 70001;
+    std::vector<uchar> edited(m_buffer.begin(), m_buffer.begin() + length);
+    const quint32 original = referenceCrc32(edited.data(), length, 0x12345678);
+
+    std::mt19937 random(42);
+    for (const size_t size : { size_t(1), size_t(2), size_t(5), size_t(9) }) {
+        for (const size_t position : { size_t(0), size_t(3), size_t(30000), length - size }) {
+            std::vector<uchar> difference(size);
+            for (uchar &c : difference) {
+                c = uchar(random() | 1);
+            }
+            for (size_t i=0; i<size; i++) {
+                edited[position + i] ^= difference[i];
+            }
+
+            const quint32 expected = referenceCrc32(edited.data(), length, 0x12345678);
+            QCOMPARE(original ^ crc32::update(difference.data(), size, length - position - size), expected);
+
+            for (size_t i=0; i<size; i++) {
+                edited[position + i] ^= difference[i];
+            }
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(TestCrc32)
+#include "tst_crc32.moc"
@@ -0,0 +1,428 @@
+#include "SaveFile.h"
+#include "SaveBuffer.h"
+#include "SaveGenerator.h"
+#include "StringPool.h"
+#include "Crc32.h"
+
+#include <QtEndian>
+#include <QtTest>
+
+#include <limits>
+
+Q_DECLARE_METATYPE(QSysInfo::Endian)
+
+namespace {
+
+// Small ones, the layout of the fields is what matters here
+QByteArray generate(const QSysInfo::Endian endian, const quint64 index)
+{
+    SaveGenerator::Options options;
+    options.endian = endian;
+    options.bundleCount = int(index % 5);
+    options.remainderSize = 1 + qint64(index) * 37;
+    return SaveGenerator::generate(options, SaveGenerator::fileSeed(0x5a7e, index));
+}
+
+bool load(SaveFile *saveFile, const QByteArray &file)
+{
+    saveFile->setRecordFieldOffsets(true);
+    return saveFile->load(file.constData(), file.size());
+}
+
+qint64 fieldOffset(const SaveFile &saveFile, const char *name)
+{
+    for (const FieldOffset &field : saveFile.fieldOffsets()) {
+        if (qstrcmp(field.name, name) == 0) {
+            return field.position;
+        }
+    }
+    return -1;
+}
+
+template<typename T>
+T readStored(const QByteArray &file, const qint64 offset, const QSysInfo::Endian endian)
+{
+    const char *data = file.constData() + offset;
+    return endian == QSysInfo::BigEndian ? qFromBigEndian<T>(data) : qFromLittleEndian<T>(data);
+}
+
+// Checks the checksums in the file against the blocks, without going through SaveFile
+bool checksumsMatch(const QByteArray &file, const QSysInfo::Endian endian)
+{
+    const qint64 headerLength = readStored<quint32>(file, 10, endian);
+    const qint64 dataLength = readStored<quint32>(file, 14, endian);
+    const qint64 headerStart = 18;
+    const qint64 dataStart = headerStart + headerLength;
+    if (dataStart + dataLength != file.size()) {
+        return false;
+    }
+
+    const uchar *data = reinterpret_cast<const uchar*>(file.constData());
+    const quint32 headerChecksum = crc32::calculate(data + headerStart + 4, size_t(headerLength - 4), 0x12345678);
+    const quint32 dataChecksum = crc32::calculate(data + dataStart + 4, size_t(dataLength - 4), 0x12345678);
+    return readStored<quint32>(file, headerStart, endian) == headerChecksum
+        && readStored<quint32>(file, dataStart, endian) == dataChecksum;
+}
+
+// Empty if saveFile is what loading file gives, otherwise what differs
+QString mismatch(SaveFile *saveFile, const QByteArray &file)
+{
+    SaveFile reloaded;
+    if (!load(&reloaded, file)) {
+        return QStringLiteral("doesn't load");
+    }
+    // Written from the members, so any of them being out of date shows up here
+    QByteArray saved;
+    if (!saveFile->save(&saved) || saved != file) {
+        return QStringLiteral("fields");
+    }
+    if (saveFile->headerChecksum() != reloaded.headerChecksum()) {
+        return QStringLiteral("header checksum");
+    }
+    if (saveFile->dataChecksum() != reloaded.dataChecksum()) {
+        return QStringLiteral("data checksum");
+    }
+    return QString();
+}
+
+} // namespace
+
+class TestSaveFile : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void patch_data();
+    void patch();
+    void patchTimestamp();
+    void patchRejected();
+
+    void undoRedo_data();
+    void undoRedo();
+
+    void roundTrip_data();
+    void roundTrip();
+    void fieldAt();
+
+    void lazyDecoding_data();
+    void lazyDecoding();
+
+private:
+    bool findSave(const QSysInfo::Endian endian, const char *field, const int bitPhase, QByteArray *file);
+};
+
+// The 4 bit flags at the start of the data block, and the 27 bits after them
+// if any of the flags are set, put the data fields at bit 4 or bit 7 of a byte
+bool TestSaveFile::findSave(const QSysInfo::Endian endian, const char *field, const int bitPhase, QByteArray *file)
+{
+    for (quint64 index = 0; index < 64; index++) {
+        *file = generate(endian, index);
+        SaveFile saveFile;
+        if (!load(&saveFile, *file)) {
+            return false;
+        }
+        const qint64 offset = fieldOffset(saveFile, field);
+        if (offset >= 0 && offset % 8 == bitPhase) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TestSaveFile::patch_data()
+{
+    QTest::addColumn<QSysInfo::Endian>("endian");
+    QTest::addColumn<QString>("field");
+    QTest::addColumn<int>("bitPhase");
+    QTest::addColumn<quint64>("value");
+
+    for (const QSysInfo::Endian endian : { QSysInfo::LittleEndian, QSysInfo::BigEndian }) {
+        const char *endianName = endian == QSysInfo::BigEndian ? "big endian" : "little endian";
+        // In the header, which is byte aligned
+        QTest::addRow("%s, version", endianName) << endian << "version" << 0 << quint64(7);
+        for (const int bitPhase : { 4, 7 }) {
+            QTest::addRow("%s, unknown1 at bit %d", endianName, bitPhase) << endian << "unknown1" << bitPhase << quint64(0xbeef);
+            QTest::addRow("%s, unknown2 at bit %d", endianName, bitPhase) << endian << "unknown2" << bitPhase << quint64(0);
+            QTest::addRow("%s, userBuildInfo at bit %d", endianName, bitPhase) << endian << "userBuildInfo" << bitPhase << quint64(0xdeadbeef);
+            QTest::addRow("%s, unknown3 at bit %d", endianName, bitPhase) << endian << "unknown3" << bitPhase << quint64(0xffffffff);
+        }
+    }
+}
+
+void TestSaveFile::patch()
+{
+    QFETCH(QSysInfo::Endian, endian);
+    QFETCH(QString, field);
+    QFETCH(int, bitPhase);
+    QFETCH(quint64, value);
+
+    const QByteArray name = field.toLatin1();
+    QByteArray file;
+    QVERIFY(findSave(endian, name.constData(), bitPhase, &file));
+
+    SaveFile saveFile;
+    QVERIFY(load(&saveFile, file));
+    QVERIFY(saveFile.patch(&file, name.constData(), value));
+
+    // The bits spliced in place should be what a full save writes
+    QByteArray saved;
+    QVERIFY(saveFile.save(&saved));
+    QCOMPARE(file, saved);
+    QVERIFY(checksumsMatch(file, endian));
+
+    SaveFile reloaded;
+    QVERIFY(load(&reloaded, file));
+    QCOMPARE(reloaded.headerChecksum(), saveFile.headerChecksum());
+    QCOMPARE(reloaded.dataChecksum(), saveFile.dataChecksum());
+}
+
+void TestSaveFile::patchTimestamp()
+{
+    for (const QSysInfo::Endian endian : { QSysInfo::LittleEndian, QSysInfo::BigEndian }) {
+        for (const int bitPhase : { 4, 7 }) {
+            QByteArray file;
+            QVERIFY(findSave(endian, "timestamp", bitPhase, &file));
+
+            SaveFile saveFile;
+            QVERIFY(load(&saveFile, file));
+            const QDateTime timestamp = QDateTime::fromSecsSinceEpoch(1500000000);
+            QVERIFY(saveFile.patch(&file, "timestamp", timestamp));
+
+            QByteArray saved;
+            QVERIFY(saveFile.save(&saved));
+            QCOMPARE(file, saved);
+            QVERIFY(checksumsMatch(file, endian));
+
+            SaveFile reloaded;
+            QVERIFY(load(&reloaded, file));
+            QCOMPARE(reloaded.data().m_timestamp, timestamp);
+        }
+    }
+}
+
+void TestSaveFile::patchRejected()
+{
+    QByteArray file = generate(QSysInfo::LittleEndian, 1);
+    const QByteArray original = file;
+
+    SaveFile saveFile;
+    QVERIFY(load(&saveFile, file));
+
+    // Decide the layout of the rest of the save
+    QVERIFY(!saveFile.patch(&file, "entryCount", 19));
+    QVERIFY(!saveFile.patch(&file, "gameVersion", 3));
+    QVERIFY(!saveFile.patch(&file, "saveVersion", 21));
+
+    // Don't fit
+    QVERIFY(!saveFile.patch(&file, "unknown1", 0x10000));
+    QVERIFY(!saveFile.patch(&file, "userBuildInfo", quint64(std::numeric_limits<quint32>::max()) + 1));
+    QVERIFY(!saveFile.patch(&file, "timestamp", QDateTime::fromSecsSinceEpoch(qint64(1) << 33)));
+    QVERIFY(!saveFile.patch(&file, "timestamp", QDateTime()));
+
+    // Not fixed width, or not a field at all
+    QVERIFY(!saveFile.patch(&file, "levelName", 1));
+    QVERIFY(!saveFile.patch(&file, "timestamp", 1));
+    QVERIFY(!saveFile.patch(&file, "noSuchField", 1));
+
+    QCOMPARE(file, original);
+}
+
+void TestSaveFile::undoRedo_data()
+{
+    QTest::addColumn<QSysInfo::Endian>("endian");
+    QTest::addColumn<int>("chunkSize");
+
+    for (const QSysInfo::Endian endian : { QSysInfo::LittleEndian, QSysInfo::BigEndian }) {
+        const char *endianName = endian == QSysInfo::BigEndian ? "big endian" : "little endian";
+        QTest::addRow("%s, default chunks", endianName) << endian << int(SaveBuffer::ChunkSize);
+        // Every field and checksum ends up split between chunks
+        QTest::addRow("%s, 3 byte chunks", endianName) << endian << 3;
+    }
+}
+
+void TestSaveFile::undoRedo()
+{
+    QFETCH(QSysInfo::Endian, endian);
+    QFETCH(int, chunkSize);
+
+    const QByteArray original = generate(endian, 3);
+    SaveFile saveFile;
+    QVERIFY(load(&saveFile, original));
+    SaveBuffer buffer(original, chunkSize);
+
+    // What the buffer should look like after each step
+    QVector<QByteArray> steps;
+    steps.append(original);
+
+    QVERIFY(saveFile.patch(&buffer, "unknown1", 0x1234));
+    buffer.commit(QStringLiteral("one field"));
+    steps.append(buffer.toByteArray());
+
+    QVERIFY(saveFile.patch(&buffer, "userBuildInfo", 0xcafebabe));
+    QVERIFY(saveFile.patch(&buffer, "unknown3", 42));
+    QVERIFY(saveFile.patch(&buffer, "version", 2));
+    buffer.commit(QStringLiteral("data and header together"));
+    steps.append(buffer.toByteArray());
+
+    QVERIFY(saveFile.patch(&buffer, "timestamp", QDateTime::fromSecsSinceEpoch(1600000000)));
+    QVERIFY(saveFile.patch(&buffer, "timestamp", QDateTime::fromSecsSinceEpoch(1700000000)));
+    buffer.commit(QStringLiteral("same field twice"));
+    steps.append(buffer.toByteArray());
+    QCOMPARE(mismatch(&saveFile, steps.last()), QString());
+
+    for (int step = steps.count() - 2; step >= 0; step--) {
+        QVERIFY(saveFile.undo(&buffer));
+        QCOMPARE(buffer.toByteArray(), steps[step]);
+        QCOMPARE(mismatch(&saveFile, steps[step]), QString());
+    }
+    QVERIFY(!saveFile.undo(&buffer));
+
+    for (int step = 1; step < steps.count(); step++) {
+        QVERIFY(saveFile.redo(&buffer));
+        QCOMPARE(buffer.toByteArray(), steps[step]);
+        QCOMPARE(mismatch(&saveFile, steps[step]), QString());
+    }
+    QVERIFY(!saveFile.redo(&buffer));
+
+    // A new edit after undoing drops what could be redone
+    QVERIFY(saveFile.undo(&buffer));
+    QVERIFY(saveFile.undo(&buffer));
+    QVERIFY(saveFile.patch(&buffer, "unknown2", 7));
+    buffer.commit(QStringLiteral("new branch"));
+    QVERIFY(!saveFile.redo(&buffer));
+    QCOMPARE(mismatch(&saveFile, buffer.toByteArray()), QString());
+
+    QVERIFY(saveFile.undo(&buffer));
+    QCOMPARE(buffer.toByteArray(), steps[1]);
+    QCOMPARE(mismatch(&saveFile, steps[1]), QString());
+}
+
+void TestSaveFile::roundTrip_data()
+{
+    QTest::addColumn<QSysInfo::Endian>("endian");
+    QTest::addColumn<int>("saveVersion");
+
+    for (const QSysInfo::Endian endian : { QSysInfo::LittleEndian, QSysInfo::BigEndian }) {
+        const char *endianName = endian == QSysInfo::BigEndian ? "big endian" : "little endian";
+        for (const int saveVersion : { 20, 21, 22 }) {
+            QTest::addRow("%s, version %d", endianName, saveVersion) << endian << saveVersion;
+        }
+    }
+}
+
+// What --verify checks, loading and saving again gives the same bytes
+void TestSaveFile::roundTrip()
+{
+    QFETCH(QSysInfo::Endian, endian);
+    QFETCH(int, saveVersion);
+
+    // The generator picks the version from the seed
+    int tested = 0;
+    for (quint64 index = 0; index < 64; index++) {
+        const QByteArray file = generate(endian, index);
+        SaveFile saveFile;
+        QVERIFY(load(&saveFile, file));
+        if (saveFile.data().m_saveVersion != saveVersion) {
+            continue;
+        }
+        QByteArray saved;
+        QVERIFY(saveFile.save(&saved));
+        QCOMPARE(saved, file);
+        tested++;
+    }
+    QVERIFY(tested > 0);
+}
+
+void TestSaveFile::fieldAt()
+{
+    const QByteArray file = generate(QSysInfo::BigEndian, 5);
+    SaveFile saveFile;
+    QVERIFY(load(&saveFile, file));
+
+    const auto nameAt = [&saveFile](const qint64 bitOffset) {
+        const char *name = saveFile.fieldAt(bitOffset);
+        return name ? QByteArray(name) : QByteArray();
+    };
+
+    QCOMPARE(nameAt(-1), QByteArray());
+    QCOMPARE(nameAt(0), QByteArray("magic"));
+    QCOMPARE(nameAt(63), QByteArray("magic"));
+
+    // 32 bits of timestamp, then the length of the file name
+    const qint64 timestamp = fieldOffset(saveFile, "timestamp");
+    QVERIFY(timestamp % 8 != 0);
+    QCOMPARE(nameAt(timestamp), QByteArray("timestamp"));
+    QCOMPARE(nameAt(timestamp + 31), QByteArray("timestamp"));
+    QCOMPARE(nameAt(timestamp + 32), QByteArray("saveFileName"));
+
+    // Each field runs up to where the next one starts
+    const QVector<FieldOffset> &fields = saveFile.fieldOffsets();
+    QVERIFY(fields.count() > 10);
+    for (int i=0; i + 1 < fields.count(); i++) {
+        if (fields[i + 1].position == fields[i].position) {
+            continue; // empty, the next one is found instead
+        }
+        QCOMPARE(nameAt(fields[i].position), QByteArray(fields[i].name));
+        QCOMPARE(nameAt(fields[i + 1].position - 1), QByteArray(fields[i].name));
+    }
+    QCOMPARE(nameAt(file.size() * 8 - 1), QByteArray("remainder"));
+}
+
+void TestSaveFile::lazyDecoding_data()
+{
+    QTest::addColumn<QSysInfo::Endian>("endian");
+    QTest::addColumn<bool>("useStringPool");
+
+    for (const QSysInfo::Endian endian : { QSysInfo::LittleEndian, QSysInfo::BigEndian }) {
+        const char *endianName = endian == QSysInfo::BigEndian ? "big endian" : "little endian";
+        QTest::addRow("%s", endianName) << endian << false;
+        QTest::addRow("%s, string pool", endianName) << endian << true;
+    }
+}
+
+void TestSaveFile::lazyDecoding()
+{
+    QFETCH(QSysInfo::Endian, endian);
+    QFETCH(bool, useStringPool);
+
+    StringPool stringPool;
+    for (quint64 index = 0; index < 16; index++) {
+        const QByteArray file = generate(endian, index);
+
+        SaveFile eager;
+        SaveFile lazy;
+        lazy.setLazyDecoding(true);
+        if (useStringPool) {
+            eager.setStringPool(&stringPool);
+            lazy.setStringPool(&stringPool);
+        }
+        QVERIFY(eager.load(file.constData(), file.size()));
+        QVERIFY(lazy.load(file.constData(), file.size()));
+
+        // Nothing decoded yet in every other one, so save() has to do it
+        if (index % 2) {
+            QCOMPARE(lazy.data().levelName(), eager.data().levelName());
+            QCOMPARE(lazy.data().saveFileName(), eager.data().saveFileName());
+            QCOMPARE(lazy.data().preloadedBundles(), eager.data().preloadedBundles());
+            QCOMPARE(lazy.data().remainder(), eager.data().remainder());
+        }
+
+        QByteArray eagerSaved;
+        QByteArray lazySaved;
+        QVERIFY(eager.save(&eagerSaved));
+        QVERIFY(lazy.save(&lazySaved));
+        QCOMPARE(lazySaved, eagerSaved);
+        QCOMPARE(lazySaved, file);
+
+        QCOMPARE(lazy.data().saveFileName(), eager.data().saveFileName());
+        QCOMPARE(lazy.data().levelName(), eager.data().levelName());
+        QCOMPARE(lazy.data().preloadedBundles(), eager.data().preloadedBundles());
+        QCOMPARE(lazy.data().remainder(), eager.data().remainder());
+        QCOMPARE(lazy.data().m_timestamp, eager.data().m_timestamp);
+        QCOMPARE(lazy.data().m_userBuildInfo, eager.data().m_userBuildInfo);
+    }
+    QCOMPARE(stringPool.count() > 0, useStringPool);
+}
+
+QTEST_GUILESS_MAIN(TestSaveFile)
+#include "tst_savefile.moc"